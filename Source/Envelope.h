@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 constexpr float SILENCE = 0.0001f; // -80 dB
 
 class Envelope
@@ -18,6 +20,66 @@ public:
         return level;
     }
 
+    // Writes the values of the next sampleCount calls to nextValue into output and returns
+    // how many samples the voice plays: it stops after the sample whose level falls to
+    // SILENCE, like a render loop that checks isActive before every sample.
+    //
+    // Within a stage the level is target + multiplier^n * (level - target), so the values
+    // come POWERS at a time from a table of powers, with one multiply to carry the chain
+    // from one group to the next. The powers and the carry are kept in double precision,
+    // as a rounded multiplier^POWERS would otherwise drift further off with every group
+    // in a long release. The result matches nextValue to within rounding.
+    int renderBlock(float* output, int sampleCount)
+    {
+        int sample = 0;
+        while (sample < sampleCount && isActive())
+        {
+            float powers[POWERS];
+            double power = 1.0;
+            for (int i = 0; i < POWERS; ++i)
+            {
+                power *= multiplier;
+                powers[i] = static_cast<float>(power);
+            }
+
+            // Runs until the stage changes, the level falls silent or the block ends.
+            double carry = level - target;
+            bool stageDone = false;
+            while (sample < sampleCount && !stageDone)
+            {
+                int count = std::min(POWERS, sampleCount - sample);
+                float* values = output + sample;
+                float base = static_cast<float>(carry);
+                for (int i = 0; i < count; ++i)
+                {
+                    values[i] = target + base * powers[i];
+                }
+
+                int i = 0;
+                while (i < count && values[i] + target <= 3.0f && values[i] > SILENCE) { ++i; }
+
+                if (i < count)
+                {
+                    level = values[i];
+                    sample += i + 1;
+                    if (level + target > 3.0f)
+                    {
+                        multiplier = decayMultiplier;
+                        target = sustainLevel;
+                    }
+                    stageDone = true;
+                }
+                else
+                {
+                    level = values[count - 1];
+                    sample += count;
+                    carry *= power;
+                }
+            }
+        }
+        return sample;
+    }
+
     void reset()
     {
         level = 0.0f;
@@ -56,6 +118,10 @@ public:
     float releaseMultiplier;
 
 private:
+    friend struct VoiceBank;
+
+    static constexpr int POWERS = 8;
+
     float multiplier;
     float target;
 };
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include "SimdFloat.h"
+
+// Polynomial replacements for the libm calls in the DSP path. Every kernel is written once
+// for T = float or T = SimdFloat, so a voice bank lane computes exactly what the scalar
+// voice computes. The float versions are constexpr.
+//
+// Largest errors against double precision libm, which Tools/FastMathCheck.cpp checks:
+//   sin, cos   |x| <= 8 pi            2e-7 absolute
+//   tan        |x| <= 1.45 (filter)   1.2e-6 relative
+//   exp        -87 <= x <= 88         1.2e-7 relative (inputs are clamped to this range)
+namespace FastMath
+{
+    // Same rounding as SimdFloat::floor, valid for |x| < 2^31.
+    constexpr float floor(float x)
+    {
+        float t = static_cast<float>(static_cast<int32_t>(x));
+        return t > x ? t - 1.0f : t;
+    }
+
+    // 2^n for whole numbers n in [-126, 127].
+    constexpr float pow2(float n)
+    {
+        return std::bit_cast<float>(static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23);
+    }
+
+    constexpr float min(float a, float b) { return a < b ? a : b; }
+    constexpr float max(float a, float b) { return a > b ? a : b; }
+
+    inline SimdFloat floor(SimdFloat x) { return SimdFloat::floor(x); }
+    inline SimdFloat pow2(SimdFloat n) { return SimdFloat::pow2(n); }
+    inline SimdFloat min(SimdFloat a, SimdFloat b) { return SimdFloat::min(a, b); }
+    inline SimdFloat max(SimdFloat a, SimdFloat b) { return SimdFloat::max(a, b); }
+    inline SimdFloat min(SimdFloat a, float b) { return SimdFloat::min(a, SimdFloat::expand(b)); }
+    inline SimdFloat max(SimdFloat a, float b) { return SimdFloat::max(a, SimdFloat::expand(b)); }
+
+    namespace detail
+    {
+        // pi split in two so that k * PI_HI is exact for the k we see.
+        constexpr float ONE_OVER_PI = 0.31830988618379067f;
+        constexpr float PI_HI = 3.140625f;
+        constexpr float PI_LO = 9.6765358979e-4f;
+
+        constexpr float LOG2_E = 1.4426950408889634f;
+        constexpr float LN2_HI = 0.693359375f;
+        constexpr float LN2_LO = -2.12194440e-4f;
+
+        // Adding and removing 1.5 * 2^23 rounds to the nearest whole number (ties to even)
+        // for |x| < 2^22, as long as the compiler is not allowed to reassociate float math.
+        constexpr float ROUNDING = 12582912.0f;
+
+        template<typename T>
+        constexpr T round(T x)
+        {
+            return (x + ROUNDING) - ROUNDING;
+        }
+
+        // Nearest multiple of pi, so that x - k * pi lies in [-pi/2, pi/2].
+        template<typename T>
+        constexpr T quadrant(T x)
+        {
+            return round(x * ONE_OVER_PI);
+        }
+
+        template<typename T>
+        constexpr T reduce(T x, T k)
+        {
+            return (x - k * PI_HI) - k * PI_LO;
+        }
+
+        // +1 for even k, -1 for odd k. Half of an odd k is 0.5 away from a whole number.
+        template<typename T>
+        constexpr T parity(T k)
+        {
+            T half = k * 0.5f;
+            T fraction = half - round(half);
+            return 1.0f - 8.0f * fraction * fraction;
+        }
+
+        // Least squares fits on [-pi/2, pi/2].
+        template<typename T>
+        constexpr T sinPoly(T r)
+        {
+            T r2 = r * r;
+            return r * (0.99999997653f + r2 * (-0.16666647603f + r2 * (0.0083328993507f
+                 + r2 * (-0.00019800872078f + r2 * 2.5904420368e-6f))));
+        }
+
+        template<typename T>
+        constexpr T cosPoly(T r)
+        {
+            T r2 = r * r;
+            return 0.99999999977f + r2 * (-0.49999999337f + r2 * (0.041666635602f
+                 + r2 * (-0.0013888354151f + r2 * (2.4759832200e-5f + r2 * -2.6046241068e-7f))));
+        }
+
+        // e^r on [-ln(2)/2, ln(2)/2].
+        template<typename T>
+        constexpr T expPoly(T r)
+        {
+            return 1.0000000005920f + r * (1.0000000361259f + r * (0.49999991492807f
+                 + r * (0.16666420832231f + r * (0.041668358079183f
+                 + r * (0.0083747715127761f + r * 0.0013829418209843f)))));
+        }
+    }
+
+    template<typename T>
+    constexpr T sin(T x)
+    {
+        T k = detail::quadrant(x);
+        return detail::parity(k) * detail::sinPoly(detail::reduce(x, k));
+    }
+
+    template<typename T>
+    constexpr T cos(T x)
+    {
+        T k = detail::quadrant(x);
+        return detail::parity(k) * detail::cosPoly(detail::reduce(x, k));
+    }
+
+    // The signs of sin and cos cancel, so tan only needs the reduced argument.
+    // Loses relative accuracy as x gets within about 1e-3 of an odd multiple of pi/2.
+    template<typename T>
+    constexpr T tan(T x)
+    {
+        T r = detail::reduce(x, detail::quadrant(x));
+        return detail::sinPoly(r) / detail::cosPoly(r);
+    }
+
+    template<typename T>
+    constexpr T exp(T x)
+    {
+        x = min(max(x, -87.0f), 88.0f);
+        T n = detail::round(x * detail::LOG2_E);
+        T r = (x - n * detail::LN2_HI) - n * detail::LN2_LO;
+        return detail::expPoly(r) * pow2(n);
+    }
+}
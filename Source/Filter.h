@@ -1,17 +1,54 @@
 #pragma once
 
+#include "FastMath.h"
+
 class Filter
 {
 public:
     float sampleRate;
     void updateCoefficients(float cutoff, float Q)
     {
-        g = std::tan(PI * cutoff / sampleRate);
+        g = FastMath::tan(PI * cutoff / sampleRate);
         k = 1.0f / Q;
         a1 = 1.0f / (1.0f + g * (g + k));
         a2 = g * a1;
         a3 = g * a2;
     }
+    // Same as updateCoefficients, with g and a1 taken from a FilterTable.
+    void setCoefficients(float g_, float a1_)
+    {
+        g = g_;
+        a1 = a1_;
+        a2 = g * a1;
+        a3 = g * a2;
+        gStep = 0.0f;
+    }
+    // Makes renderRamped move g to this value in equal steps over the next 1 / inverseSteps
+    // samples. a1 is tracked from its current value, so right after a reset (the only time
+    // a1 is zero) the coefficients are set straight away instead.
+    void rampCoefficients(float g_, float a1_, float damping, float inverseSteps)
+    {
+        k = damping;
+        if (a1 == 0.0f)
+        {
+            setCoefficients(g_, a1_);
+            return;
+        }
+        gStep = (g_ - g) * inverseSteps;
+    }
+    // Moves g one step along the ramp before filtering. a1 follows 1 / (1 + g * (g + k))
+    // with two Newton steps from its value one sample ago, which is close enough to start
+    // from even when the cutoff sweeps across the whole table within one ramp.
+    float renderRamped(float x)
+    {
+        g += gStep;
+        float d = 1.0f + g * (g + k);
+        a1 = a1 * (2.0f - a1 * d);
+        a1 = a1 * (2.0f - a1 * d);
+        a2 = g * a1;
+        a3 = g * a2;
+        return render(x);
+    }
     void reset()
     {
         g = 0.0f;
@@ -19,6 +56,7 @@ public:
         a1 = 0.0f;
         a2 = 0.0f;
         a3 = 0.0f;
+        gStep = 0.0f;
         ic1eq = 0.0f;
         ic2eq = 0.0f;
     }
@@ -31,8 +69,22 @@ public:
         ic2eq = 2.0f * v2 - ic2eq;
         return v2;
     }
+    // Filters a second signal with the same coefficients, for the right channel of a stereo
+    // voice. The caller keeps the state of that signal.
+    float render(float x, float& state1, float& state2) const
+    {
+        float v3 = x - state2;
+        float v1 = a1 * state1 + a2 * v3;
+        float v2 = state2 + a2 * state1 + a3 * v3;
+        state1 = 2.0f * v1 - state1;
+        state2 = 2.0f * v2 - state2;
+        return v2;
+    }
 private:
-    const float PI = 3.1415926535897932f;
+    friend struct VoiceBank;
+
+    static constexpr float PI = 3.1415926535897932f;
     float g, k, a1, a2, a3; // filter coefficients
+    float gStep;            // per sample change of g while ramping
     float ic1eq, ic2eq; // internal state
 };
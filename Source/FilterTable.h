@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "FastMath.h"
+
+// SVF coefficients sampled over log-cutoff and damping (1/Q), so a voice can update its
+// filter with a few multiply-adds instead of a tan and a divide. Only g and a1 are stored,
+// a2 and a3 follow from them.
+class FilterTable
+{
+public:
+    static constexpr float MIN_CUTOFF = 30.0f;
+    static constexpr float MAX_CUTOFF = 20000.0f;
+    static constexpr int CUTOFF_STEPS = 192;
+    static constexpr int DAMPING_STEPS = 33;  // damping 0 to 1, Q is never below 1
+
+    // Called for every new sample rate. The top cutoff stays below Nyquist for rates
+    // where 20 kHz would not.
+    void build(float sampleRate)
+    {
+        float maxCutoff = std::min(MAX_CUTOFF, 0.49f * sampleRate);
+        logMin = std::log(MIN_CUTOFF);
+        logMax = std::log(maxCutoff);
+        cutoffScale = static_cast<float>(CUTOFF_STEPS - 1) / (logMax - logMin);
+
+        gs.resize(CUTOFF_STEPS);
+        a1s.resize(CUTOFF_STEPS * DAMPING_STEPS);
+        for (int i = 0; i < CUTOFF_STEPS; ++i)
+        {
+            double cutoff = std::exp(logMin + i / static_cast<double>(cutoffScale));
+            double g = std::tan(3.141592653589793 * cutoff / sampleRate);
+            gs[static_cast<size_t>(i)] = static_cast<float>(g);
+            for (int j = 0; j < DAMPING_STEPS; ++j)
+            {
+                double k = j / static_cast<double>(DAMPING_STEPS - 1);
+                a1s[static_cast<size_t>(i * DAMPING_STEPS + j)] = static_cast<float>(1.0 / (1.0 + g * (g + k)));
+            }
+        }
+    }
+
+    // Bilinear lookup. Cutoffs outside the table are clamped to its ends, like the
+    // std::clamp on the cutoff in Hz that this replaces.
+    //
+    // Near Nyquist the interpolated a1 can be a percent off from 1 / (1 + g * (g + k)) for
+    // the interpolated g, which at high Q amounts to a very different damping. Two Newton
+    // steps on the reciprocal bring a1 back in line with g to float precision.
+    void lookup(float logCutoff, float damping, float& g, float& a1) const
+    {
+        float x = FastMath::min(FastMath::max((logCutoff - logMin) * cutoffScale, 0.0f),
+                                static_cast<float>(CUTOFF_STEPS - 1));
+        float y = FastMath::min(FastMath::max(damping, 0.0f), 1.0f) * static_cast<float>(DAMPING_STEPS - 1);
+
+        int i = std::min(static_cast<int>(x), CUTOFF_STEPS - 2);
+        int j = std::min(static_cast<int>(y), DAMPING_STEPS - 2);
+        float fx = x - static_cast<float>(i);
+        float fy = y - static_cast<float>(j);
+
+        const float* row = a1s.data() + i * DAMPING_STEPS + j;
+        float a1Low = row[0] + fy * (row[1] - row[0]);
+        float a1High = row[DAMPING_STEPS] + fy * (row[DAMPING_STEPS + 1] - row[DAMPING_STEPS]);
+
+        g = gs[static_cast<size_t>(i)] + fx * (gs[static_cast<size_t>(i + 1)] - gs[static_cast<size_t>(i)]);
+        a1 = a1Low + fx * (a1High - a1Low);
+
+        float d = 1.0f + g * (g + damping);
+        a1 = a1 * (2.0f - a1 * d);
+        a1 = a1 * (2.0f - a1 * d);
+    }
+
+private:
+    float logMin = 0.0f;
+    float logMax = 0.0f;
+    float cutoffScale = 0.0f;
+    std::vector<float> gs;
+    std::vector<float> a1s;
+};
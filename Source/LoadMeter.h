@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Builds with JX11_LOAD_METER=1 time the audio thread's work against its deadline. Without
+// it the processor has no meter and JX11_MEASURE_LOAD is nothing at all.
+#ifndef JX11_LOAD_METER
+#define JX11_LOAD_METER 0
+#endif
+
+// How long each section of the audio thread's work takes, as a fraction of the time the
+// samples it works on last, which is the deadline it has to beat.
+//
+// Only the audio thread measures. Every section keeps a histogram of the load, the worst and
+// the sum, in atomics that the audio thread stores to without locking, allocating or
+// read-modify-writes, so any other thread can read them while it runs. Such a reading can
+// be a block behind in places, which does not matter for a display.
+class LoadMeter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Section
+    {
+        BLOCK,   // all of processBlock
+        UPDATE,  // reading the changed parameters at the start of a block
+        RENDER,  // a segment of Synth::render between two events
+        NUM_SECTIONS
+    };
+
+    // The histogram has bins of 2% of the deadline, the last one for 200% and more.
+    static constexpr int BINS = 101;
+    static constexpr double BIN_WIDTH = 0.02;
+
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        uint64_t overruns = 0;  // over the deadline
+        double mean = 0.0;
+        double worst = 0.0;
+        std::array<uint64_t, BINS> histogram {};
+
+        // The load that fraction p of the measurements stayed under, to a bin's width.
+        double percentile(double p) const
+        {
+            uint64_t target = static_cast<uint64_t>(p * static_cast<double>(count));
+            uint64_t sum = 0;
+            for (int bin = 0; bin < BINS; ++bin)
+            {
+                sum += histogram[static_cast<size_t>(bin)];
+                if (sum > target || sum == count) { return (bin + 1) * BIN_WIDTH; }
+            }
+            return 0.0;
+        }
+    };
+
+    // Measures until the end of the scope.
+    class Scope
+    {
+    public:
+        Scope(LoadMeter& meter, Section section, int sampleCount)
+            : meter(meter), section(section), sampleCount(sampleCount), start(Clock::now())
+        {
+        }
+
+        ~Scope()
+        {
+            meter.add(section, Clock::now() - start, sampleCount);
+        }
+
+    private:
+        LoadMeter& meter;
+        Section section;
+        int sampleCount;
+        Clock::time_point start;
+    };
+
+    // Call before the audio thread starts, or while it is stopped.
+    void prepare(double sampleRate)
+    {
+        nanosecondsPerSample = 1e9 / sampleRate;
+        clear();
+    }
+
+    // Any thread. The audio thread starts over before its next measurement.
+    void reset()
+    {
+        resetRequested.store(true, std::memory_order_relaxed);
+    }
+
+    Snapshot read(Section section) const
+    {
+        const Measurements& m = measurements[section];
+        Snapshot snapshot;
+        snapshot.count = m.count.load(std::memory_order_relaxed);
+        snapshot.overruns = m.overruns.load(std::memory_order_relaxed);
+        snapshot.worst = m.worst.load(std::memory_order_relaxed);
+        if (snapshot.count > 0)
+        {
+            snapshot.mean = m.sum.load(std::memory_order_relaxed) / static_cast<double>(snapshot.count);
+        }
+        for (size_t bin = 0; bin < BINS; ++bin)
+        {
+            snapshot.histogram[bin] = m.histogram[bin].load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    // The histograms for offline analysis: a "section,load,count" line per bin, where load
+    // is the upper edge of the bin as a fraction of the deadline.
+    std::string toCsv() const
+    {
+        static constexpr const char* names[NUM_SECTIONS] = { "block", "update", "render" };
+        std::ostringstream csv;
+        csv << "section,load,count\n";
+        for (int section = 0; section < NUM_SECTIONS; ++section)
+        {
+            Snapshot snapshot = read(static_cast<Section>(section));
+            for (int bin = 0; bin < BINS; ++bin)
+            {
+                csv << names[section] << "," << (bin + 1) * BIN_WIDTH << ","
+                    << snapshot.histogram[static_cast<size_t>(bin)] << "\n";
+            }
+        }
+        return csv.str();
+    }
+
+private:
+    struct Measurements
+    {
+        std::atomic<uint64_t> count { 0 };
+        std::atomic<uint64_t> overruns { 0 };
+        std::atomic<double> sum { 0.0 };
+        std::atomic<double> worst { 0.0 };
+        std::array<std::atomic<uint64_t>, BINS> histogram {};
+    };
+
+    // Only the audio thread writes, so a load and a store are enough.
+    template<typename T>
+    static void increment(std::atomic<T>& value, T amount = 1)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void add(Section section, Clock::duration elapsed, int sampleCount)
+    {
+        if (sampleCount <= 0) { return; }
+        if (resetRequested.load(std::memory_order_relaxed))
+        {
+            resetRequested.store(false, std::memory_order_relaxed);
+            clear();
+        }
+
+        double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        double load = nanoseconds / (nanosecondsPerSample * sampleCount);
+
+        Measurements& m = measurements[section];
+        int bin = load < BINS * BIN_WIDTH ? static_cast<int>(load / BIN_WIDTH) : BINS - 1;
+        increment(m.histogram[static_cast<size_t>(bin)]);
+        increment(m.count);
+        increment(m.sum, load);
+        if (load > 1.0) { increment(m.overruns); }
+        if (load > m.worst.load(std::memory_order_relaxed)) { m.worst.store(load, std::memory_order_relaxed); }
+    }
+
+    void clear()
+    {
+        for (Measurements& m : measurements)
+        {
+            m.count.store(0, std::memory_order_relaxed);
+            m.overruns.store(0, std::memory_order_relaxed);
+            m.sum.store(0.0, std::memory_order_relaxed);
+            m.worst.store(0.0, std::memory_order_relaxed);
+            for (auto& bin : m.histogram) { bin.store(0, std::memory_order_relaxed); }
+        }
+    }
+
+    double nanosecondsPerSample = 1e9 / 44100.0;
+    std::array<Measurements, NUM_SECTIONS> measurements;
+    std::atomic<bool> resetRequested { false };
+};
+
+#if JX11_LOAD_METER
+#define JX11_MEASURE_LOAD(meter, section, sampleCount) \
+    LoadMeter::Scope loadScope(meter, LoadMeter::section, sampleCount)
+#else
+#define JX11_MEASURE_LOAD(meter, section, sampleCount)
+#endif
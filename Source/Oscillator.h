@@ -1,6 +1,18 @@
 #pragma once
 
 #include <cmath>
+#include "FastMath.h"
+#include "Wavetable.h"
+
+// nextSample has to be inlined into the voice loop for the oscillator state to stay in
+// registers, and the setup done once per period is better off out of the way.
+#if defined(_MSC_VER)
+#define JX11_FORCEINLINE __forceinline
+#define JX11_NOINLINE __declspec(noinline)
+#else
+#define JX11_FORCEINLINE inline __attribute__((always_inline))
+#define JX11_NOINLINE __attribute__((noinline))
+#endif
 
 constexpr float TWO_PI = 6.2831853071795864f;
 constexpr float PI = 3.1415926535897932f;
@@ -13,6 +25,9 @@ public:
     float amplitude = 1.0f;
     float modulation = 1.0f;
 
+    // Reads from these band-limited tables instead of running the BLIT when set.
+    const Wavetable* wavetable = nullptr;
+
     void reset()
     {
         inc = 0.0f;
@@ -22,9 +37,21 @@ public:
         sin0 = 0.0f;
         sin1 = 0.0f;
         dsin = 0.0f;
+
+        tablePhase = 1.0f;
+        tableInc = 0.0f;
     }
 
     float nextSample()
+    {
+        if (wavetable != nullptr)
+        {
+            return nextTableSample();
+        }
+        return nextBlitSample();
+    }
+
+    JX11_FORCEINLINE float nextBlitSample()
     {
         float output = 0.0f;
 
@@ -32,26 +59,7 @@ public:
 
         if (phase <= PI_OVER_4)
         {
-            float halfPeriod = (period / 2.0f) * modulation;
-            phaseMax = std::floor(0.5f + halfPeriod) - 0.5f;
-            dc = 0.5f * amplitude / phaseMax;
-            phaseMax *= PI;
-
-            inc = phaseMax / halfPeriod;
-            phase = -phase;
-
-            sin0 = amplitude * std::sin(phase);
-            sin1 = amplitude * std::sin(phase - inc);
-            dsin = 2.0f * std::cos(inc);
-
-            if (phase*phase > 1e-9)
-            {
-                output = sin0 / phase;
-            }
-            else
-            {
-                output = amplitude;
-            }
+            output = startHalfPeriod();
         }
         else
         {
@@ -71,10 +79,45 @@ public:
         return output - dc;
     }
 
+    JX11_FORCEINLINE float nextTableSample()
+    {
+        tablePhase += tableInc;
+        if (tablePhase >= 1.0f)
+        {
+            tablePhase -= 1.0f;
+            startTablePeriod();
+        }
+
+        float position = tablePhase * static_cast<float>(Wavetable::SIZE);
+        int index = static_cast<int>(position);
+        float fraction = position - static_cast<float>(index);
+        float a = table[index];
+        float b = table[index + 1];
+        return tableScale * (a + fraction * (b - a));
+    }
+
+    // For an oscillator copied from one whose wavetable was at fromWavetable, with its tables
+    // at fromTables: points it at the same place in to.
+    void rebase(const Wavetable* fromWavetable, const float* fromTables, const Wavetable& to)
+    {
+        if (wavetable == fromWavetable) { wavetable = &to; }
+        if (table != nullptr) { table = to.data() + (table - fromTables); }
+    }
+
     void squareWave(Oscillator& other, float newPeriod)
     {
         reset();
 
+        if (wavetable != nullptr)
+        {
+            // Trails the other oscillator by half of newPeriod, like the BLIT does.
+            // Staying above 1 makes the first sample pick up the period and table like a wrap would.
+            float offset = period > 0.0f ? 0.5f * newPeriod / period : 0.5f;
+            tablePhase = other.tablePhase - offset;
+            tablePhase = tablePhase - std::floor(tablePhase) + 1.0f;
+            return;
+        }
+
         if (other.inc > 0.0f)
         {
             phase = other.phaseMax + other.phaseMax - other.phase;
@@ -96,6 +139,72 @@ public:
     }
 
 private:
+    friend struct OscillatorLanes;
+
+    // Sets up the sine recurrence for the next half period and returns its first sample.
+    float startHalfPeriod()
+    {
+        HalfPeriod next = halfPeriodStart(period, modulation, amplitude, phase);
+        phase = next.phase;
+        phaseMax = next.phaseMax;
+        inc = next.inc;
+        dc = next.dc;
+        sin0 = next.sin0;
+        sin1 = next.sin1;
+        dsin = next.dsin;
+        return next.output;
+    }
+
+    struct HalfPeriod
+    {
+        float phase, phaseMax, inc, dc, sin0, sin1, dsin, output;
+    };
+
+    // Works on copies and returns the new state, so the oscillator that calls it never has
+    // its address taken and the compiler can keep it in registers during the voice loop.
+    static JX11_NOINLINE HalfPeriod halfPeriodStart(float period, float modulation, float amplitude, float phase)
+    {
+        HalfPeriod next;
+        float halfPeriod = (period / 2.0f) * modulation;
+        next.phaseMax = FastMath::floor(0.5f + halfPeriod) - 0.5f;
+        next.dc = 0.5f * amplitude / next.phaseMax;
+        next.phaseMax *= PI;
+
+        next.inc = next.phaseMax / halfPeriod;
+        next.phase = -phase;
+
+        next.sin0 = amplitude * FastMath::sin(next.phase);
+        next.sin1 = amplitude * FastMath::sin(next.phase - next.inc);
+        next.dsin = 2.0f * FastMath::cos(next.inc);
+
+        next.output = amplitude;
+        if (next.phase * next.phase > 1e-9f)
+        {
+            next.output = next.sin0 / next.phase;
+        }
+        return next;
+    }
+
+    // Pitch and level are only picked up once per period, which leaves one divide per period.
+    void startTablePeriod()
+    {
+        TablePeriod next = tablePeriodStart(*wavetable, period * modulation, amplitude);
+        tableInc = next.inc;
+        tableScale = next.scale;
+        table = next.table;
+    }
+
+    struct TablePeriod
+    {
+        float inc, scale;
+        const float* table;
+    };
+
+    static JX11_NOINLINE TablePeriod tablePeriodStart(const Wavetable& wavetable, float samples, float amplitude)
+    {
+        float inc = 1.0f / samples;
+        return { inc, 2.0f * amplitude * inc, wavetable.forPeriod(samples) };
+    }
 
     float sin0;
     float sin1;
@@ -105,4 +214,10 @@ private:
     float phaseMax = 0.0f;
     float inc = 0.0f;
     float dc = 0.0f;
+
+    // Wavetable state, with the phase in cycles.
+    const float* table = nullptr;
+    float tablePhase = 1.0f;
+    float tableInc = 0.0f;
+    float tableScale = 0.0f;
 };
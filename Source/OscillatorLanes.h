@@ -0,0 +1,129 @@
+#pragma once
+
+#include "FastMath.h"
+#include "Oscillator.h"
+#include "SimdFloat.h"
+
+// One float per SIMD lane, aligned for SimdFloat::load and store.
+struct alignas(SimdFloat::alignment) LaneArray
+{
+    float x[SimdFloat::size];
+};
+
+// The BLIT of Oscillator for several oscillators at once, one per SIMD lane. gather copies
+// the state of the oscillators into the lanes and scatter copies it back, so the Oscillator
+// objects stay the owners of the state between runs.
+struct OscillatorLanes
+{
+    static constexpr int LANES = SimdFloat::size;
+
+    SimdFloat period, modulation, amplitude;
+    SimdFloat phase, phaseMax, inc, dc, sin0, sin1, dsin;
+
+    void gather(Oscillator* const* oscs, int count)
+    {
+        LaneArray p{}, m{}, a{}, ph{}, pm{}, i{}, d{}, s0{}, s1{}, ds{};
+        for (int lane = 0; lane < LANES; ++lane)
+        {
+            // Unused lanes get a harmless state that never restarts or divides by zero.
+            p.x[lane] = 100.0f;
+            m.x[lane] = 1.0f;
+            ph.x[lane] = 1.0f;
+            pm.x[lane] = 2.0f;
+        }
+        for (int lane = 0; lane < count; ++lane)
+        {
+            const Oscillator& osc = *oscs[lane];
+            p.x[lane] = osc.period;
+            m.x[lane] = osc.modulation;
+            a.x[lane] = osc.amplitude;
+            ph.x[lane] = osc.phase;
+            pm.x[lane] = osc.phaseMax;
+            i.x[lane] = osc.inc;
+            d.x[lane] = osc.dc;
+            s0.x[lane] = osc.sin0;
+            s1.x[lane] = osc.sin1;
+            ds.x[lane] = osc.dsin;
+        }
+        period = SimdFloat::load(p.x);
+        modulation = SimdFloat::load(m.x);
+        amplitude = SimdFloat::load(a.x);
+        phase = SimdFloat::load(ph.x);
+        phaseMax = SimdFloat::load(pm.x);
+        inc = SimdFloat::load(i.x);
+        dc = SimdFloat::load(d.x);
+        sin0 = SimdFloat::load(s0.x);
+        sin1 = SimdFloat::load(s1.x);
+        dsin = SimdFloat::load(ds.x);
+    }
+
+    void scatter(Oscillator* const* oscs, int count) const
+    {
+        LaneArray ph, pm, i, d, s0, s1, ds;
+        phase.store(ph.x);
+        phaseMax.store(pm.x);
+        inc.store(i.x);
+        dc.store(d.x);
+        sin0.store(s0.x);
+        sin1.store(s1.x);
+        dsin.store(ds.x);
+        for (int lane = 0; lane < count; ++lane)
+        {
+            Oscillator& osc = *oscs[lane];
+            osc.phase = ph.x[lane];
+            osc.phaseMax = pm.x[lane];
+            osc.inc = i.x[lane];
+            osc.dc = d.x[lane];
+            osc.sin0 = s0.x[lane];
+            osc.sin1 = s1.x[lane];
+            osc.dsin = ds.x[lane];
+        }
+    }
+
+    SimdFloat nextSample(int usedLanes)
+    {
+        SimdFloat newPhase = phase + inc;
+
+        // Regular step of the sine recurrence, mirroring the phase at the end of the half period.
+        SimdFloat reflect = SimdFloat::greaterThan(newPhase, phaseMax);
+        phase = SimdFloat::select(reflect, phaseMax + phaseMax - newPhase, newPhase);
+        inc = SimdFloat::select(reflect, -inc, inc);
+
+        SimdFloat sinp = dsin * sin0 - sin1;
+        sin1 = sin0;
+        sin0 = sinp;
+        SimdFloat output = sinp / phase;
+
+        // Lanes that start a new half period. The setup is done for all lanes with the same
+        // steps as Oscillator::startHalfPeriod and only kept where a lane actually restarts.
+        SimdFloat restart = SimdFloat::lessOrEqual(newPhase, SimdFloat::expand(PI_OVER_4));
+        if ((SimdFloat::bitmask(restart) & usedLanes) != 0)
+        {
+            SimdFloat halfPeriod = (period * 0.5f) * modulation;
+            SimdFloat newPhaseMax = FastMath::floor(0.5f + halfPeriod) - 0.5f;
+            SimdFloat newDc = 0.5f * amplitude / newPhaseMax;
+            newPhaseMax = newPhaseMax * PI;
+
+            SimdFloat newInc = newPhaseMax / halfPeriod;
+            SimdFloat startPhase = -newPhase;
+
+            SimdFloat newSin0 = amplitude * FastMath::sin(startPhase);
+            SimdFloat newSin1 = amplitude * FastMath::sin(startPhase - newInc);
+            SimdFloat newDsin = 2.0f * FastMath::cos(newInc);
+
+            SimdFloat awayFromZero = SimdFloat::greaterThan(startPhase * startPhase, SimdFloat::expand(1e-9f));
+            SimdFloat firstSample = SimdFloat::select(awayFromZero, newSin0 / startPhase, amplitude);
+
+            phase = SimdFloat::select(restart, startPhase, phase);
+            phaseMax = SimdFloat::select(restart, newPhaseMax, phaseMax);
+            inc = SimdFloat::select(restart, newInc, inc);
+            dc = SimdFloat::select(restart, newDc, dc);
+            sin0 = SimdFloat::select(restart, newSin0, sin0);
+            sin1 = SimdFloat::select(restart, newSin1, sin1);
+            dsin = SimdFloat::select(restart, newDsin, dsin);
+            output = SimdFloat::select(restart, firstSample, output);
+        }
+
+        return output - dc;
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Parameter changes on their way from whichever thread made them to the audio thread.
+//
+// Any number of threads may push, only the audio thread pops. Every cell carries a sequence
+// number that tells writers and the reader whose turn it is, so neither side locks or
+// allocates. A push fails when the queue is full.
+class ParameterQueue
+{
+public:
+    struct Change
+    {
+        int sampleOffset;  // position in the next processBlock call
+        int slot;          // which parameter, as numbered by the processor
+        float value;       // plain value, as the parameter's get() would return it
+    };
+
+    static constexpr size_t CAPACITY = 1024;  // a power of two
+
+    ParameterQueue()
+    {
+        for (size_t i = 0; i < CAPACITY; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const Change& change)
+    {
+        size_t position = writePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = cells[position & (CAPACITY - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.change = change;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (sequence < position)
+            {
+                return false;  // the reader has not got this far yet
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(Change& change)
+    {
+        Cell& cell = cells[readPosition & (CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != readPosition + 1)
+        {
+            return false;
+        }
+        change = cell.change;
+        cell.sequence.store(readPosition + CAPACITY, std::memory_order_release);
+        ++readPosition;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Change change;
+    };
+
+    Cell cells[CAPACITY];
+    std::atomic<size_t> writePosition { 0 };
+    size_t readPosition = 0;
+};
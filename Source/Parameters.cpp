@@ -40,6 +40,13 @@ Parameters::Parameters(juce::AudioProcessorValueTreeState& apvts)
   castParameter(apvts, ParameterID::tuning, tuningParam);
   castParameter(apvts, ParameterID::outputLevel, outputLevelParam);
   castParameter(apvts, ParameterID::polyMode, polyModeParam);
+  castParameter(apvts, ParameterID::oscEngine, oscEngineParam);
+  castParameter(apvts, ParameterID::filterRate, filterRateParam);
+  castParameter(apvts, ParameterID::midiMode, midiModeParam);
+  castParameter(apvts, ParameterID::unison, unisonParam);
+  castParameter(apvts, ParameterID::unisonDetune, unisonDetuneParam);
+  castParameter(apvts, ParameterID::unisonSpread, unisonSpreadParam);
+  castParameter(apvts, ParameterID::morph, morphParam);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout Parameters::createParameterLayout()
@@ -52,6 +59,13 @@ juce::AudioProcessorValueTreeState::ParameterLayout Parameters::createParameterL
     juce::NormalisableRange<float>(1.0f, static_cast<float>(Synth::MAX_VOICES), 1.0f),
     1));
 
+  // Omni plays one patch on all channels, Multi gives every channel a part of its own.
+  layout.add(std::make_unique<juce::AudioParameterChoice>(
+    ParameterID::midiMode,
+    "MIDI Mode",
+    juce::StringArray{"Omni", "Multi"},
+    0));
+
   layout.add(std::make_unique<juce::AudioParameterFloat>(
     ParameterID::oscTune,
     "Osc Tune",
@@ -82,6 +96,33 @@ juce::AudioProcessorValueTreeState::ParameterLayout Parameters::createParameterL
     .withLabel("%")
     .withStringFromValueFunction(oscMixStringFromValue)));
 
+  layout.add(std::make_unique<juce::AudioParameterChoice>(
+    ParameterID::oscEngine,
+    "Osc Engine",
+    juce::StringArray{"BLIT", "Wavetable"},
+    0));
+
+  // Copies of both oscillators per note, detuned and spread across the stereo field.
+  layout.add(std::make_unique<juce::AudioParameterFloat>(
+    ParameterID::unison,
+    "Unison",
+    juce::NormalisableRange<float>(1.0f, static_cast<float>(Unison::MAX_COPIES), 1.0f),
+    1.0f));
+
+  layout.add(std::make_unique<juce::AudioParameterFloat>(
+    ParameterID::unisonDetune,
+    "Unison Detune",
+    juce::NormalisableRange<float>(0.0f, 100.0f, 1.0f),
+    25.0f,
+    juce::AudioParameterFloatAttributes().withLabel("%")));
+
+  layout.add(std::make_unique<juce::AudioParameterFloat>(
+    ParameterID::unisonSpread,
+    "Unison Spread",
+    juce::NormalisableRange<float>(0.0f, 100.0f, 1.0f),
+    50.0f,
+    juce::AudioParameterFloatAttributes().withLabel("%")));
+
   layout.add(std::make_unique<juce::AudioParameterChoice>(
     ParameterID::glideMode,
     "Glide Mode",
@@ -175,6 +216,12 @@ juce::AudioProcessorValueTreeState::ParameterLayout Parameters::createParameterL
     25.0f,
     juce::AudioParameterFloatAttributes().withLabel("%")));
 
+  layout.add(std::make_unique<juce::AudioParameterChoice>(
+    ParameterID::filterRate,
+    "Filter Rate",
+    juce::StringArray{"Control", "Audio"},
+    0));
+
   layout.add(std::make_unique<juce::AudioParameterFloat>(
     ParameterID::envAttack,
     "Env Attack",
@@ -271,5 +318,13 @@ juce::AudioProcessorValueTreeState::ParameterLayout Parameters::createParameterL
     0.0f,
     juce::AudioParameterFloatAttributes().withLabel("dB")));
 
+  // How far part 0 is from morph program A to B, when the processor has both.
+  layout.add(std::make_unique<juce::AudioParameterFloat>(
+    ParameterID::morph,
+    "Morph",
+    juce::NormalisableRange<float>(0.0f, 100.0f, 0.1f),
+    0.0f,
+    juce::AudioParameterFloatAttributes().withLabel("%")));
+
   return layout;
 }
@@ -31,6 +31,13 @@ namespace ParameterID
     PARAMETER_ID(tuning)
     PARAMETER_ID(outputLevel)
     PARAMETER_ID(polyMode)
+    PARAMETER_ID(oscEngine)
+    PARAMETER_ID(filterRate)
+    PARAMETER_ID(midiMode)
+    PARAMETER_ID(unison)
+    PARAMETER_ID(unisonDetune)
+    PARAMETER_ID(unisonSpread)
+    PARAMETER_ID(morph)
     #undef PARAMETER_ID
 }
 
@@ -67,6 +74,13 @@ public:
     juce::AudioParameterFloat* tuningParam;
     juce::AudioParameterFloat* outputLevelParam;
     juce::AudioParameterFloat* polyModeParam;
+    juce::AudioParameterChoice* oscEngineParam;
+    juce::AudioParameterChoice* filterRateParam;
+    juce::AudioParameterChoice* midiModeParam;
+    juce::AudioParameterFloat* unisonParam;
+    juce::AudioParameterFloat* unisonDetuneParam;
+    juce::AudioParameterFloat* unisonSpreadParam;
+    juce::AudioParameterFloat* morphParam;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Parameters)
 };
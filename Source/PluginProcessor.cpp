@@ -9,6 +9,9 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 #include "ProtectYourEars.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
 
 //==============================================================================
 JX11AudioProcessor::JX11AudioProcessor()
@@ -24,14 +27,67 @@ JX11AudioProcessor::JX11AudioProcessor()
       params(apvts)
 #endif
 {
-    apvts.state.addListener(this);
-    createPrograms();
+    slotParameters = {
+        params.oscMixParam,
+        params.oscTuneParam,
+        params.oscFineParam,
+        params.glideModeParam,
+        params.glideRateParam,
+        params.glideBendParam,
+        params.filterFreqParam,
+        params.filterResoParam,
+        params.filterEnvParam,
+        params.filterLFOParam,
+        params.filterVelocityParam,
+        params.filterAttackParam,
+        params.filterDecayParam,
+        params.filterSustainParam,
+        params.filterReleaseParam,
+        params.envAttackParam,
+        params.envDecayParam,
+        params.envSustainParam,
+        params.envReleaseParam,
+        params.lfoRateParam,
+        params.vibratoParam,
+        params.noiseParam,
+        params.octaveParam,
+        params.tuningParam,
+        params.outputLevelParam,
+        params.polyModeParam,
+        params.oscEngineParam,
+        params.lfoWaveformParam,
+        params.filterRateParam,
+        params.unisonParam,
+        params.unisonDetuneParam,
+        params.unisonSpreadParam,
+        params.morphParam,
+        params.midiModeParam,
+    };
+
+    parameterSlots.assign(static_cast<size_t>(getParameters().size()), -1);
+    for (int slot = 0; slot < NUM_SLOTS; ++slot)
+    {
+        parameterSlots[static_cast<size_t>(slotParameters[slot]->getParameterIndex())] = slot;
+        slotChoices[slot] = dynamic_cast<juce::AudioParameterChoice*>(slotParameters[slot]);
+    }
+    jassert(std::find(parameterSlots.begin(), parameterSlots.end(), -1) == parameterSlots.end());
+    for (auto* parameter : getParameters())
+    {
+        parameter->addListener(this);
+    }
+
+    makeStateHeader();
+    prepareProgramValues();
     setCurrentProgram(0);
+    startTimerHz(30);
 }
 
 JX11AudioProcessor::~JX11AudioProcessor()
 {
-    apvts.state.removeListener(this);
+    for (auto* parameter : getParameters())
+    {
+        parameter->removeListener(this);
+    }
 }
 
 //==============================================================================
@@ -74,7 +130,7 @@ double JX11AudioProcessor::getTailLengthSeconds() const
 
 int JX11AudioProcessor::getNumPrograms()
 {
-    return static_cast<int>(presets.size());
+    return presets.size();
 }
 
 int JX11AudioProcessor::getCurrentProgram()
@@ -85,44 +141,18 @@ int JX11AudioProcessor::getCurrentProgram()
 void JX11AudioProcessor::setCurrentProgram (int index)
 {
     currentProgram = index;
-    juce::RangedAudioParameter *params_[NUM_PARAMS] = {
-        params.oscMixParam,
-        params.oscTuneParam,
-        params.oscFineParam,
-        params.glideModeParam,
-        params.glideRateParam,
-        params.glideBendParam,
-        params.filterFreqParam,
-        params.filterResoParam,
-        params.filterEnvParam,
-        params.filterLFOParam,
-        params.filterVelocityParam,
-        params.filterAttackParam,
-        params.filterDecayParam,
-        params.filterSustainParam,
-        params.filterReleaseParam,
-        params.envAttackParam,
-        params.envDecayParam,
-        params.envSustainParam,
-        params.envReleaseParam,
-        params.lfoRateParam,
-        params.vibratoParam,
-        params.noiseParam,
-        params.octaveParam,
-        params.tuningParam,
-        params.outputLevelParam,
-        params.polyModeParam,
-        };
-    const Preset& preset = presets[index];
+    float param[NUM_PARAMS];
+    readProgramValues(index, param);
+    partPrograms[0].store(index);
     for (int i = 0; i < NUM_PARAMS; ++i) {
-        params_[i]->setValueNotifyingHost(params_[i]->convertTo0to1(preset.param[i]));
+        slotParameters[i]->setValueNotifyingHost(slotParameters[i]->convertTo0to1(param[i]));
     }
     reset();
 }
 
 const juce::String JX11AudioProcessor::getProgramName (int index)
 {
-    return { presets[index].name };
+    return presets.getName(index);
 }
 
 void JX11AudioProcessor::changeProgramName ([[maybe_unused]] int index, [[maybe_unused]] const juce::String& newName)
@@ -133,8 +163,12 @@ void JX11AudioProcessor::changeProgramName ([[maybe_unused]] int index, [[maybe_
 //==============================================================================
 void JX11AudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    synth.allocateResources(sampleRate, samplesPerBlock);
-    parametersChanged.store(true);
+    synth.allocateResources(sampleRate, samplesPerBlock, Synth::MAX_VOICES);
+#if JX11_LOAD_METER
+    loadMeter.prepare(sampleRate);
+#endif
+    dirtySlots.store(ALL_SLOTS);
+    morphChanged.store(true);  // the patch values depend on the sample rate
     reset();
 }
 
@@ -146,7 +180,12 @@ void JX11AudioProcessor::releaseResources()
 void JX11AudioProcessor::reset()
 {
     synth.reset();
-    synth.outputLevelSmoother.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(params.outputLevelParam->get()));
+    synth.parts[0].outputLevelSmoother.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(params.outputLevelParam->get()));
+    for (int p = 1; p < Synth::NUM_PARTS; ++p)
+    {
+        synth.parts[p].outputLevelSmoother.setCurrentAndTargetValue(
+            juce::Decibels::decibelsToGain(partValues[static_cast<size_t>(p)][PresetParam::outputLevel]));
+    }
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -177,31 +216,116 @@ bool JX11AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) con
 void JX11AudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
-
-    float noiseMix = params.noiseParam->get() / 100.0f;
-    noiseMix *= noiseMix;
-    synth.noiseMix = noiseMix * 0.06f;
+    JX11_MEASURE_LOAD(loadMeter, BLOCK, buffer.getNumSamples());
 
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    bool expected = true;
-    if (isNonRealtime() || parametersChanged.compare_exchange_strong(expected, false))
+    if (statsResetRequested.exchange(false))
+    {
+        synth.stats.reset();
+        for (auto* counter : { &blockCount, &totalSegments, &silentBlocks, &clippedSamples, &silencedSamples })
+        {
+            counter->store(0, std::memory_order_relaxed);
+        }
+        mostSegmentsInABlock.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t dirty = dirtySlots.exchange(0);
+    if (dirty != 0)
+    {
+        JX11_MEASURE_LOAD(loadMeter, UPDATE, buffer.getNumSamples());
+        update(dirty);
+    }
+    if (morphChanged.exchange(false))
     {
-        update();
+        prepareMorph();
     }
 
+    collectParameterChanges(buffer.getNumSamples());
     splitBufferByEvents(buffer, midiMessages);
+    countOutput(buffer);
 
 #if JUCE_DEBUG
-    protectYourEars(buffer);
+    if (protectYourEars(buffer))
+    {
+        Synth::Stats::add(silencedSamples, static_cast<uint64_t>(buffer.getNumChannels() * buffer.getNumSamples()));
+    }
 #endif
 }
 
+// Counts the blocks that came out silent and the samples past full scale. Most blocks stay
+// within full scale, so only those that do not are gone through sample by sample.
+void JX11AudioProcessor::countOutput(const juce::AudioBuffer<float>& buffer) noexcept
+{
+    bool silent = true;
+    uint64_t clipped = 0;
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        const float* samples = buffer.getReadPointer(channel);
+        auto range = juce::FloatVectorOperations::findMinAndMax(samples, buffer.getNumSamples());
+        silent = silent && range.getStart() == 0.0f && range.getEnd() == 0.0f;
+        if (range.getStart() < -1.0f || range.getEnd() > 1.0f)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                if (std::abs(samples[i]) > 1.0f) { ++clipped; }
+            }
+        }
+    }
+
+    if (silent) { Synth::Stats::add(silentBlocks); }
+    if (clipped > 0) { Synth::Stats::add(clippedSamples, clipped); }
+}
+
+JX11AudioProcessor::EngineStats JX11AudioProcessor::getEngineStats() const
+{
+    EngineStats result;
+    result.blocks = blockCount.load(std::memory_order_relaxed);
+    result.samples = synth.stats.samples.load(std::memory_order_relaxed);
+    if (result.samples > 0)
+    {
+        result.averageVoices = static_cast<double>(synth.stats.voiceSamples.load(std::memory_order_relaxed))
+                             / static_cast<double>(result.samples);
+    }
+    result.peakVoices = synth.stats.peakVoices.load(std::memory_order_relaxed);
+    result.voiceSteals = synth.stats.voiceSteals.load(std::memory_order_relaxed);
+    result.monoShifts = synth.stats.monoShifts.load(std::memory_order_relaxed);
+    result.voiceEnds = synth.stats.voiceEnds.load(std::memory_order_relaxed);
+    if (result.blocks > 0)
+    {
+        result.averageSegments = static_cast<double>(totalSegments.load(std::memory_order_relaxed))
+                               / static_cast<double>(result.blocks);
+    }
+    result.mostSegments = mostSegmentsInABlock.load(std::memory_order_relaxed);
+    result.silentBlocks = silentBlocks.load(std::memory_order_relaxed);
+    result.clippedSamples = clippedSamples.load(std::memory_order_relaxed);
+    result.silencedSamples = silencedSamples.load(std::memory_order_relaxed);
+    return result;
+}
+
+// The audio thread starts over at its next block.
+void JX11AudioProcessor::resetEngineStats()
+{
+    statsResetRequested.store(true);
+}
+
+juce::String JX11AudioProcessor::EngineStats::toString() const
+{
+    return "blocks " + juce::String(static_cast<juce::int64>(blocks))
+         + ", voices average " + juce::String(averageVoices, 2) + " peak " + juce::String(peakVoices)
+         + ", steals " + juce::String(static_cast<juce::int64>(voiceSteals))
+         + ", mono shifts " + juce::String(static_cast<juce::int64>(monoShifts))
+         + ", voice ends " + juce::String(static_cast<juce::int64>(voiceEnds))
+         + ", segments per block average " + juce::String(averageSegments, 2) + " most " + juce::String(mostSegments)
+         + ", silent blocks " + juce::String(static_cast<juce::int64>(silentBlocks))
+         + ", clipped samples " + juce::String(static_cast<juce::int64>(clippedSamples))
+         + ", silenced samples " + juce::String(static_cast<juce::int64>(silencedSamples));
+}
+
 //==============================================================================
 bool JX11AudioProcessor::hasEditor() const
 {
@@ -216,123 +340,467 @@ juce::AudioProcessorEditor* JX11AudioProcessor::createEditor()
 }
 
 //==============================================================================
+// The state is saved in the binary format SavedState describes. A state whose ID table is the
+// same as ours has its values read straight into the parameters. Otherwise each value goes to
+// the parameter with its ID, for a state saved by a version with other parameters. States
+// saved as XML by earlier versions still load.
+static void writeUInt32(uint8_t*& out, uint32_t value)
+{
+    value = juce::ByteOrder::swapIfBigEndian(value);
+    std::memcpy(out, &value, 4);
+    out += 4;
+}
+
+static void writeFloat32(uint8_t*& out, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    writeUInt32(out, bits);
+}
+
+// The part of the state that is the same every time: the header and the ID table.
+void JX11AudioProcessor::makeStateHeader()
+{
+    juce::MemoryOutputStream ids;
+    for (auto* parameter : getParameters())
+    {
+        juce::String id = static_cast<juce::RangedAudioParameter*>(parameter)->getParameterID();
+        jassert(id.getNumBytesAsUTF8() < 256);
+        ids.writeByte(static_cast<char>(id.getNumBytesAsUTF8()));
+        ids.write(id.toRawUTF8(), id.getNumBytesAsUTF8());
+    }
+
+    stateHeader.setSize(SavedState::HEADER_SIZE + ids.getDataSize());
+    auto* out = static_cast<uint8_t*>(stateHeader.getData());
+    std::memcpy(out, SavedState::MAGIC, sizeof(SavedState::MAGIC));
+    out += sizeof(SavedState::MAGIC);
+    writeUInt32(out, SavedState::VERSION);
+    writeUInt32(out, static_cast<uint32_t>(getParameters().size()));
+    writeUInt32(out, static_cast<uint32_t>(ids.getDataSize()));
+    std::memcpy(out, ids.getData(), ids.getDataSize());
+}
+
 void JX11AudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    copyXmlToBinary(*apvts.copyState().createXml(), destData);
+    const auto& parameters = getParameters();
+    juce::String bankPath = presets.getFile().getFullPathName();
+    size_t pathSize = bankPath.getNumBytesAsUTF8();
+
+    destData.setSize(stateHeader.getSize() + 4 * parameters.size() + 4 + 4 * Synth::NUM_PARTS + 8 + 4 + pathSize);
+    auto* out = static_cast<uint8_t*>(destData.getData());
+    std::memcpy(out, stateHeader.getData(), stateHeader.getSize());
+    out += stateHeader.getSize();
+
+    for (auto* parameter : parameters)
+    {
+        auto* ranged = static_cast<juce::RangedAudioParameter*>(parameter);
+        writeFloat32(out, ranged->convertFrom0to1(ranged->getValue()));
+    }
+
+    writeUInt32(out, Synth::NUM_PARTS);
+    for (const auto& program : partPrograms)
+    {
+        writeUInt32(out, static_cast<uint32_t>(program.load()));
+    }
+    writeUInt32(out, static_cast<uint32_t>(morphPrograms[0].load()));
+    writeUInt32(out, static_cast<uint32_t>(morphPrograms[1].load()));
+
+    writeUInt32(out, static_cast<uint32_t>(pathSize));
+    std::memcpy(out, bankPath.toRawUTF8(), pathSize);
 }
 
 void JX11AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
-    if (xml.get() != nullptr && xml->hasTagName(apvts.state.getType()))
+    SavedState state;
+    if (sizeInBytes <= 0 || !state.read(data, static_cast<size_t>(sizeInBytes))) { return; }
+
+    if (auto* xml = state.getXml())
     {
+        if (!xml->hasTagName(apvts.state.getType())) { return; }
         apvts.replaceState(juce::ValueTree::fromXml(*xml));
-        parametersChanged.store(true);
-    }
-}
-
-void JX11AudioProcessor::createPrograms()
-{
-     presets.emplace_back("Init", 0.00f, -12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 100.00f, 15.00f, 50.00f, 0.00f, 0.00f, 0.00f, 30.00f, 0.00f, 25.00f, 0.00f, 50.00f, 100.00f, 30.00f, 0.81f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("5th Sweep Pad", 100.00f, -7.00f, -6.30f, 1.00f, 32.00f, 0.00f, 90.00f, 60.00f, -76.00f, 0.00f, 0.00f, 90.00f, 89.00f, 90.00f, 73.00f, 0.00f, 50.00f, 100.00f, 71.00f, 0.81f, 30.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Echo Pad [SA]", 88.00f, 0.00f, 0.00f, 0.00f, 49.00f, 0.00f, 46.00f, 76.00f, 38.00f, 10.00f, 38.00f, 100.00f, 86.00f, 76.00f, 57.00f, 30.00f, 80.00f, 68.00f, 66.00f, 0.79f, -74.00f, 25.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Space Chimes [SA]", 88.00f, 0.00f, 0.00f, 0.00f, 49.00f, 0.00f, 49.00f, 82.00f, 32.00f, 8.00f, 78.00f, 85.00f, 69.00f, 76.00f, 47.00f, 12.00f, 22.00f, 55.00f, 66.00f, 0.89f, -32.00f, 0.00f, 2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Solid Backing", 100.00f, -12.00f, -18.70f, 0.00f, 35.00f, 0.00f, 30.00f, 25.00f, 40.00f, 0.00f, 26.00f, 0.00f, 35.00f, 0.00f, 25.00f, 0.00f, 50.00f, 100.00f, 30.00f, 0.81f, 0.00f, 50.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Velocity Backing [SA]", 41.00f, 0.00f, 9.70f, 0.00f, 8.00f, -1.68f, 49.00f, 1.00f, -32.00f, 0.00f, 86.00f, 61.00f, 87.00f, 100.00f, 93.00f, 11.00f, 48.00f, 98.00f, 32.00f, 0.81f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Rubber Backing [ZF]", 29.00f, 12.00f, -5.60f, 0.00f, 18.00f, 5.06f, 35.00f, 15.00f, 54.00f, 14.00f, 8.00f, 0.00f, 42.00f, 13.00f, 21.00f, 0.00f, 56.00f, 0.00f, 32.00f, 0.20f, 16.00f, 22.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("808 State Lead", 100.00f, 7.00f, -7.10f, 2.00f, 34.00f, 12.35f, 65.00f, 63.00f, 50.00f, 16.00f, 0.00f, 0.00f, 30.00f, 0.00f, 25.00f, 17.00f, 50.00f, 100.00f, 3.00f, 0.81f, 0.00f, 0.00f, 1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Mono Glide", 0.00f, -12.00f, 0.00f, 2.00f, 46.00f, 0.00f, 51.00f, 0.00f, 0.00f, 0.00f, -100.00f, 0.00f, 30.00f, 0.00f, 25.00f, 37.00f, 50.00f, 100.00f, 38.00f, 0.81f, 24.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Detuned Techno Lead", 84.00f, 0.00f, -17.20f, 2.00f, 41.00f, -0.15f, 54.00f, 1.00f, 16.00f, 21.00f, 34.00f, 0.00f, 9.00f, 100.00f, 25.00f, 20.00f, 85.00f, 100.00f, 30.00f, 0.83f, -82.00f, 40.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Hard Lead [SA]", 71.00f, 12.00f, 0.00f, 0.00f, 24.00f, 36.00f, 56.00f, 52.00f, 38.00f, 19.00f, 40.00f, 100.00f, 14.00f, 65.00f, 95.00f, 7.00f, 91.00f, 100.00f, 15.00f, 0.84f, -34.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Bubble", 0.00f, -12.00f, -0.20f, 0.00f, 71.00f, -0.00f, 23.00f, 77.00f, 60.00f, 32.00f, 26.00f, 40.00f, 18.00f, 66.00f, 14.00f, 0.00f, 38.00f, 65.00f, 16.00f, 0.48f, 0.00f, 0.00f, 1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Monosynth", 62.00f, -12.00f, 0.00f, 1.00f, 35.00f, 0.02f, 64.00f, 39.00f, 2.00f, 65.00f, -100.00f, 7.00f, 52.00f, 24.00f, 84.00f, 13.00f, 30.00f, 76.00f, 21.00f, 0.58f, -40.00f, 0.00f, -1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Moogcury Lite", 81.00f, 24.00f, -9.80f, 1.00f, 15.00f, -0.97f, 39.00f, 17.00f, 38.00f, 40.00f, 24.00f, 0.00f, 47.00f, 19.00f, 37.00f, 0.00f, 50.00f, 20.00f, 33.00f, 0.38f, 6.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Gangsta Whine", 0.00f, 0.00f, 0.00f, 2.00f, 44.00f, 0.00f, 41.00f, 46.00f, 0.00f, 0.00f, -100.00f, 0.00f, 0.00f, 100.00f, 25.00f, 15.00f, 50.00f, 100.00f, 32.00f, 0.81f, -2.00f, 0.00f, 2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Higher Synth [ZF]", 48.00f, 0.00f, -8.80f, 0.00f, 0.00f, 0.00f, 50.00f, 47.00f, 46.00f, 30.00f, 60.00f, 0.00f, 10.00f, 0.00f, 7.00f, 0.00f, 42.00f, 0.00f, 22.00f, 0.21f, 18.00f, 16.00f, 2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("303 Saw Bass", 0.00f, 0.00f, 0.00f, 1.00f, 49.00f, 0.00f, 55.00f, 75.00f, 38.00f, 35.00f, 0.00f, 0.00f, 56.00f, 0.00f, 56.00f, 0.00f, 80.00f, 100.00f, 24.00f, 0.26f, -2.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("303 Square Bass", 75.00f, 0.00f, 0.00f, 1.00f, 49.00f, 0.00f, 55.00f, 75.00f, 38.00f, 35.00f, 0.00f, 14.00f, 49.00f, 0.00f, 39.00f, 0.00f, 80.00f, 100.00f, 24.00f, 0.26f, -2.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Analog Bass", 100.00f, -12.00f, -10.90f, 1.00f, 19.00f, 0.00f, 30.00f, 51.00f, 70.00f, 9.00f, -100.00f, 0.00f, 88.00f, 0.00f, 21.00f, 0.00f, 50.00f, 100.00f, 46.00f, 0.81f, 0.00f, 0.00f, -1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Analog Bass 2", 100.00f, -12.00f, -10.90f, 0.00f, 19.00f, 13.44f, 48.00f, 43.00f, 88.00f, 0.00f, 60.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 61.00f, 100.00f, 32.00f, 0.81f, 0.00f, 0.00f, -1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Low Pulses", 97.00f, -12.00f, -3.30f, 0.00f, 35.00f, 0.00f, 80.00f, 40.00f, 4.00f, 0.00f, 0.00f, 0.00f, 77.00f, 0.00f, 25.00f, 0.00f, 50.00f, 100.00f, 30.00f, 0.81f, -68.00f, 0.00f, -2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Sine Infra-Bass", 0.00f, -12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 33.00f, 76.00f, 6.00f, 0.00f, 0.00f, 0.00f, 30.00f, 0.00f, 25.00f, 0.00f, 55.00f, 25.00f, 30.00f, 0.81f, 4.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Wobble Bass [SA]", 100.00f, -12.00f, -8.80f, 0.00f, 82.00f, 0.21f, 72.00f, 47.00f, -32.00f, 34.00f, 64.00f, 20.00f, 69.00f, 100.00f, 15.00f, 9.00f, 50.00f, 100.00f, 7.00f, 0.81f, -8.00f, 0.00f, -1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Squelch Bass", 100.00f, -12.00f, -8.80f, 0.00f, 35.00f, 0.00f, 67.00f, 70.00f, -48.00f, 0.00f, 0.00f, 48.00f, 69.00f, 100.00f, 15.00f, 0.00f, 50.00f, 100.00f, 7.00f, 0.81f, -8.00f, 0.00f, -1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Rubber Bass [ZF]", 49.00f, -12.00f, 1.60f, 1.00f, 35.00f, 0.00f, 36.00f, 15.00f, 50.00f, 20.00f, 0.00f, 0.00f, 38.00f, 0.00f, 25.00f, 0.00f, 60.00f, 100.00f, 22.00f, 0.19f, 0.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Soft Pick Bass", 37.00f, 0.00f, 7.80f, 0.00f, 22.00f, 0.00f, 33.00f, 47.00f, 42.00f, 16.00f, 18.00f, 0.00f, 0.00f, 0.00f, 25.00f, 4.00f, 58.00f, 0.00f, 22.00f, 0.15f, -12.00f, 33.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Fretless Bass", 50.00f, 0.00f, -14.40f, 1.00f, 34.00f, 0.00f, 51.00f, 0.00f, 16.00f, 0.00f, 34.00f, 0.00f, 9.00f, 0.00f, 25.00f, 20.00f, 85.00f, 0.00f, 30.00f, 0.81f, 40.00f, 0.00f, -2.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Whistler", 23.00f, 0.00f, -0.70f, 0.00f, 35.00f, 0.00f, 33.00f, 100.00f, 0.00f, 0.00f, 0.00f, 0.00f, 29.00f, 0.00f, 25.00f, 68.00f, 39.00f, 58.00f, 36.00f, 0.81f, 28.00f, 38.00f, 2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Very Soft Pad", 39.00f, 0.00f, -4.90f, 2.00f, 12.00f, 0.00f, 35.00f, 78.00f, 0.00f, 0.00f, 0.00f, 0.00f, 30.00f, 0.00f, 25.00f, 35.00f, 50.00f, 80.00f, 70.00f, 0.81f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Pizzicato", 0.00f, -12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 23.00f, 20.00f, 50.00f, 0.00f, 0.00f, 0.00f, 22.00f, 0.00f, 25.00f, 0.00f, 47.00f, 0.00f, 30.00f, 0.81f, 0.00f, 80.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Synth Strings", 100.00f, 0.00f, -7.10f, 0.00f, 0.00f, -0.97f, 42.00f, 26.00f, 50.00f, 14.00f, 38.00f, 0.00f, 67.00f, 55.00f, 97.00f, 82.00f, 70.00f, 100.00f, 42.00f, 0.84f, 34.00f, 30.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Synth Strings 2", 75.00f, 0.00f, -3.80f, 0.00f, 49.00f, 0.00f, 55.00f, 16.00f, 38.00f, 8.00f, -60.00f, 76.00f, 29.00f, 76.00f, 100.00f, 46.00f, 80.00f, 100.00f, 39.00f, 0.79f, -46.00f, 0.00f, 1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Leslie Organ", 0.00f, 0.00f, 0.00f, 0.00f, 13.00f, -0.38f, 38.00f, 74.00f, 8.00f, 20.00f, -100.00f, 0.00f, 55.00f, 52.00f, 31.00f, 0.00f, 17.00f, 73.00f, 28.00f, 0.87f, -52.00f, 0.00f, -1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Click Organ", 50.00f, 12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 44.00f, 50.00f, 30.00f, 16.00f, -100.00f, 0.00f, 0.00f, 18.00f, 0.00f, 0.00f, 75.00f, 80.00f, 0.00f, 0.81f, -2.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Hard Organ", 89.00f, 19.00f, -0.90f, 0.00f, 35.00f, 0.00f, 51.00f, 62.00f, 8.00f, 0.00f, -100.00f, 0.00f, 37.00f, 0.00f, 100.00f, 4.00f, 8.00f, 72.00f, 4.00f, 0.77f, -2.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Bass Clarinet", 100.00f, 0.00f, 0.00f, 1.00f, 0.00f, 0.00f, 51.00f, 10.00f, 0.00f, 11.00f, 0.00f, 0.00f, 0.00f, 0.00f, 25.00f, 35.00f, 65.00f, 65.00f, 32.00f, 0.79f, -2.00f, 20.00f, -1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Trumpet", 0.00f, 0.00f, 0.00f, 1.00f, 6.00f, 0.00f, 57.00f, 0.00f, -36.00f, 15.00f, 0.00f, 21.00f, 15.00f, 0.00f, 25.00f, 24.00f, 60.00f, 80.00f, 10.00f, 0.75f, 10.00f, 25.00f, 1.00f, 0.00f, 0.00f, 0.00f);
-    presets.emplace_back("Soft Horn", 12.00f, 19.00f, 1.90f, 0.00f, 35.00f, 0.00f, 50.00f, 21.00f, -42.00f, 12.00f, 20.00f, 0.00f, 35.00f, 36.00f, 25.00f, 8.00f, 50.00f, 100.00f, 27.00f, 0.83f, 2.00f, 10.00f, -1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Brass Section", 43.00f, 12.00f, -7.90f, 0.00f, 28.00f, -0.79f, 50.00f, 0.00f, 18.00f, 0.00f, 0.00f, 24.00f, 16.00f, 91.00f, 8.00f, 17.00f, 50.00f, 80.00f, 45.00f, 0.81f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Synth Brass", 40.00f, 0.00f, -6.30f, 0.00f, 30.00f, -3.07f, 39.00f, 15.00f, 50.00f, 0.00f, 0.00f, 39.00f, 30.00f, 82.00f, 25.00f, 33.00f, 74.00f, 76.00f, 41.00f, 0.81f, -6.00f, 23.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Detuned Syn Brass [ZF]", 68.00f, 0.00f, 31.80f, 0.00f, 31.00f, 0.50f, 26.00f, 7.00f, 70.00f, 0.00f, 32.00f, 0.00f, 83.00f, 0.00f, 5.00f, 0.00f, 75.00f, 54.00f, 32.00f, 0.76f, -26.00f, 29.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Power PWM", 100.00f, -12.00f, -8.80f, 0.00f, 35.00f, 0.00f, 82.00f, 13.00f, 50.00f, 0.00f, -100.00f, 24.00f, 30.00f, 88.00f, 34.00f, 0.00f, 50.00f, 100.00f, 48.00f, 0.71f, -26.00f, 0.00f, -1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Water Velocity [SA]", 76.00f, 0.00f, -1.40f, 0.00f, 49.00f, 0.00f, 87.00f, 67.00f, 100.00f, 32.00f, -82.00f, 95.00f, 56.00f, 72.00f, 100.00f, 4.00f, 76.00f, 11.00f, 46.00f, 0.88f, 44.00f, 0.00f, -1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Ghost [SA]", 75.00f, 0.00f, -7.10f, 2.00f, 16.00f, -0.00f, 38.00f, 58.00f, 50.00f, 16.00f, 62.00f, 0.00f, 30.00f, 40.00f, 31.00f, 37.00f, 50.00f, 100.00f, 54.00f, 0.85f, 66.00f, 43.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Soft E.Piano", 31.00f, 0.00f, -0.20f, 0.00f, 35.00f, 0.00f, 34.00f, 26.00f, 6.00f, 0.00f, 26.00f, 0.00f, 22.00f, 0.00f, 39.00f, 0.00f, 80.00f, 0.00f, 44.00f, 0.81f, 2.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Thumb Piano", 72.00f, 15.00f, 50.00f, 0.00f, 35.00f, 0.00f, 37.00f, 47.00f, 8.00f, 0.00f, 0.00f, 0.00f, 45.00f, 0.00f, 39.00f, 0.00f, 39.00f, 0.00f, 48.00f, 0.81f, 20.00f, 0.00f, 1.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Steel Drums [ZF]", 81.00f, 12.00f, -12.00f, 0.00f, 18.00f, 2.30f, 40.00f, 30.00f, 8.00f, 17.00f, -20.00f, 0.00f, 42.00f, 23.00f, 47.00f, 12.00f, 48.00f, 0.00f, 49.00f, 0.53f, -28.00f, 34.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Car Horn", 57.00f, -1.00f, -2.80f, 0.00f, 35.00f, 0.00f, 46.00f, 0.00f, 36.00f, 0.00f, 0.00f, 46.00f, 30.00f, 100.00f, 23.00f, 30.00f, 50.00f, 100.00f, 31.00f, 1.00f, -24.00f, 0.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Helicopter", 0.00f, -12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 8.00f, 36.00f, 38.00f, 100.00f, 0.00f, 100.00f, 100.00f, 0.00f, 100.00f, 96.00f, 50.00f, 100.00f, 92.00f, 0.97f, 0.00f, 100.00f, -2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Arctic Wind", 0.00f, -12.00f, 0.00f, 0.00f, 35.00f, 0.00f, 16.00f, 85.00f, 0.00f, 28.00f, 0.00f, 37.00f, 30.00f, 0.00f, 25.00f, 89.00f, 50.00f, 100.00f, 89.00f, 0.24f, 0.00f, 100.00f, 2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Thip", 100.00f, -7.00f, 0.00f, 0.00f, 35.00f, 0.00f, 0.00f, 100.00f, 94.00f, 0.00f, 0.00f, 2.00f, 20.00f, 0.00f, 20.00f, 0.00f, 46.00f, 0.00f, 30.00f, 0.81f, 0.00f, 78.00f, 0.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Synth Tom", 0.00f, -12.00f, 0.00f, 0.00f, 76.00f, 24.53f, 30.00f, 33.00f, 52.00f, 0.00f, 36.00f, 0.00f, 59.00f, 0.00f, 59.00f, 10.00f, 50.00f, 0.00f, 50.00f, 0.81f, 0.00f, 70.00f, -2.00f, 0.00f, 0.00f, 8.00f);
-    presets.emplace_back("Squelchy Frog", 50.00f, -5.00f, -7.90f, 2.00f, 77.00f, -36.00f, 40.00f, 65.00f, 90.00f, 0.00f, 0.00f, 33.00f, 50.00f, 0.00f, 25.00f, 0.00f, 70.00f, 65.00f, 18.00f, 0.32f, 100.00f, 0.00f, -2.00f, 0.00f, 0.00f, 8.00f);
+    }
+    else
+    {
+        readParameters(state);
+    }
+
+    int programCount = std::min(static_cast<int>(state.partPrograms.size()), Synth::NUM_PARTS);
+    restoreSettings(state.bankPath, state.partPrograms.data(), programCount, state.morphA, state.morphB);
+}
+
+// Set while the processor sets parameters whose slots it marks dirty itself: when timerCallback
+// brings them in line with a program the audio thread already plays, or when a state is read.
+static thread_local bool quietParameterChanges = false;
+
+void JX11AudioProcessor::readParameters(const SavedState& state)
+{
+    const auto& parameters = getParameters();
+    quietParameterChanges = true;
+
+    // A state cut short or damaged can have our ID table and fewer values, which the path by
+    // ID copes with.
+    if (state.getNumValues() == static_cast<int>(parameters.size())
+        && state.getIdTableSize() == stateHeader.getSize() - SavedState::HEADER_SIZE
+        && std::memcmp(state.getIdTable(), static_cast<const uint8_t*>(stateHeader.getData()) + SavedState::HEADER_SIZE, state.getIdTableSize()) == 0)
+    {
+        for (size_t i = 0; i < parameters.size(); ++i)
+        {
+            auto* ranged = static_cast<juce::RangedAudioParameter*>(parameters[i]);
+            float value = ranged->convertTo0to1(state.getValue(static_cast<int>(i)));
+            if (value != ranged->getValue()) { ranged->setValueNotifyingHost(value); }
+        }
+    }
+    else
+    {
+        // Parameters the state does not have go back to their defaults.
+        std::vector<bool> restored(parameters.size(), false);
+        for (const auto& [id, value] : state.getParameters())
+        {
+            auto* ranged = apvts.getParameter(id);
+            if (ranged == nullptr) { continue; }
+
+            ranged->setValueNotifyingHost(ranged->convertTo0to1(value));
+            restored[static_cast<size_t>(ranged->getParameterIndex())] = true;
+        }
+        for (size_t i = 0; i < parameters.size(); ++i)
+        {
+            if (!restored[i]) { parameters[i]->setValueNotifyingHost(parameters[i]->getDefaultValue()); }
+        }
+    }
+
+    quietParameterChanges = false;
+}
+
+// The rest of the state, once the parameters are in.
+void JX11AudioProcessor::restoreSettings(const juce::String& bankPath, const int* programs, int programCount, int morphA, int morphB)
+{
+    // A bank that has gone missing leaves the presets as they are.
+    juce::File bank = bankPath.isEmpty() ? juce::File() : juce::File(bankPath);
+    if (bank != presets.getFile() && (bank == juce::File() || bank.existsAsFile()))
+    {
+        loadPresetBank(bank);
+    }
+
+    suspendProcessing(true);
+    for (int p = 0; p < programCount; ++p)
+    {
+        int program = juce::jlimit(0, getNumPrograms() - 1, programs[p]);
+        partPrograms[p].store(program);
+        if (p > 0) { readProgramValues(program, partValues[static_cast<size_t>(p)].data()); }
+    }
+    suspendProcessing(false);
+
+    setMorphPrograms(morphA, morphB);
+    dirtySlots.store(ALL_SLOTS);
+}
+
+// Messages that only set a value the synth reads while rendering, so that a later one of the
+// same kind makes them pointless. The sustain pedal releases notes and the other controllers
+// may reset it, so those have to stay where they are.
+static bool isContinuousController(uint8_t data0, uint8_t data1, int morphController)
+{
+    switch (data0 & 0xF0)
+    {
+    case 0xA0:  // poly pressure, not used by the synth
+    case 0xD0:
+    case 0xE0:
+        return true;
+    case 0xB0:
+        return data1 == 0x01 || data1 == 0x47 || data1 == 0x4A || data1 == 0x4B || data1 == morphController;
+    default:
+        return false;
+    }
 }
 
 void JX11AudioProcessor::splitBufferByEvents(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     int bufferOffset = 0;
+    segmentCount = 0;
+
+    // The windows end on control ticks, so a value that is only read at the tick comes out
+    // the same whether its messages were merged or not.
+    int windowShift = 0;
+    if (controllerWindow > 0)
+    {
+        windowShift = controllerWindow - 1 - synth.nextTickPosition() % controllerWindow;
+    }
 
     for (const auto metadata : midiMessages)
     {
+        // Ignore MIDI messages such as sysex
+        if (metadata.numBytes > 3) { continue; }
+
+        uint8_t data0 = metadata.data[0];
+        uint8_t data1 = (metadata.numBytes >= 2) ? metadata.data[1] : 0;
+        uint8_t data2 = (metadata.numBytes == 3) ? metadata.data[2] : 0;
+
+        if (controllerWindow > 0 && isContinuousController(data0, data1, synth.morphController))
+        {
+            if (heldCount == MAX_HELD_CONTROLLERS
+                || (heldCount > 0 && (metadata.samplePosition + windowShift) / controllerWindow
+                                     != (heldPosition + windowShift) / controllerWindow))
+            {
+                releaseControllers(buffer, bufferOffset);
+            }
+            holdController(data0, data1, data2, metadata.samplePosition);
+            continue;
+        }
+
+        // Everything else comes after the controllers that came before it.
+        releaseControllers(buffer, bufferOffset);
+
         // Render audio up to this event
-        int samplesThisSegment = metadata.samplePosition - bufferOffset;
-        if (samplesThisSegment > 0)
+        renderUpTo(buffer, metadata.samplePosition, bufferOffset);
+        handleMIDI(data0, data1, data2);
+    }
+
+    // Rendering audio after last MIDI event or whole buffer if no events
+    releaseControllers(buffer, bufferOffset);
+    renderUpTo(buffer, buffer.getNumSamples(), bufferOffset);
+
+    midiMessages.clear();
+
+    segmentsInLastBlock.store(segmentCount, std::memory_order_relaxed);
+    Synth::Stats::add(totalSegments, static_cast<uint64_t>(segmentCount));
+    Synth::Stats::add(blockCount);
+    if (segmentCount > mostSegmentsInABlock.load(std::memory_order_relaxed))
+    {
+        mostSegmentsInABlock.store(segmentCount, std::memory_order_relaxed);
+    }
+}
+
+// A new value replaces the held one of the same controller and moves to the back.
+void JX11AudioProcessor::holdController(uint8_t data0, uint8_t data1, uint8_t data2, int position)
+{
+    // Pitch bend and channel pressure have one value per channel, the others one per number.
+    bool numbered = (data0 & 0xF0) == 0xA0 || (data0 & 0xF0) == 0xB0;
+
+    for (int i = 0; i < heldCount; ++i)
+    {
+        const HeldController& held = heldControllers[static_cast<size_t>(i)];
+        if (held.data0 == data0 && (!numbered || held.data1 == data1))
+        {
+            std::copy(heldControllers.begin() + i + 1, heldControllers.begin() + heldCount, heldControllers.begin() + i);
+            --heldCount;
+            mergedControllers.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    heldControllers[static_cast<size_t>(heldCount++)] = { data0, data1, data2 };
+    heldPosition = position;
+}
+
+void JX11AudioProcessor::releaseControllers(juce::AudioBuffer<float>& buffer, int& bufferOffset)
+{
+    if (heldCount == 0) { return; }
+
+    renderUpTo(buffer, heldPosition, bufferOffset);
+    for (int i = 0; i < heldCount; ++i)
+    {
+        const HeldController& held = heldControllers[static_cast<size_t>(i)];
+        handleMIDI(held.data0, held.data1, held.data2);
+    }
+    heldCount = 0;
+}
+
+// Takes the parameter changes that came in since the last block, ordered by position.
+void JX11AudioProcessor::collectParameterChanges(int sampleCount)
+{
+    changeCount = 0;
+    nextChange = 0;
+
+    ParameterQueue::Change change;
+    while (changeCount < static_cast<int>(pendingChanges.size()) && parameterQueue.pop(change))
+    {
+        change.sampleOffset = juce::jlimit(0, sampleCount, change.sampleOffset);
+
+        // Most changes come in order, so the insertion sort hardly moves anything. It also
+        // keeps changes at the same position in the order they were made.
+        int i = changeCount++;
+        while (i > 0 && pendingChanges[static_cast<size_t>(i - 1)].sampleOffset > change.sampleOffset)
         {
-            render(buffer, samplesThisSegment, bufferOffset);
-            bufferOffset += samplesThisSegment;
+            pendingChanges[static_cast<size_t>(i)] = pendingChanges[static_cast<size_t>(i - 1)];
+            --i;
         }
+        pendingChanges[static_cast<size_t>(i)] = change;
+    }
+}
+
+// Renders up to position, applying the parameter changes on the way at their own samples.
+// Changes at position itself are applied before the MIDI event there.
+void JX11AudioProcessor::renderUpTo(juce::AudioBuffer<float>& buffer, int position, int& bufferOffset)
+{
+    while (true)
+    {
+        bool changeDue = nextChange < changeCount
+                      && pendingChanges[static_cast<size_t>(nextChange)].sampleOffset <= position;
+        int end = changeDue ? pendingChanges[static_cast<size_t>(nextChange)].sampleOffset : position;
 
-        // Handle event. Ignore MIDI messages such as sysex
-        if (metadata.numBytes <= 3)
+        if (end > bufferOffset)
         {
-            uint8_t data1 = (metadata.numBytes >= 2) ? metadata.data[1] : 0;
-            uint8_t data2 = (metadata.numBytes == 3) ? metadata.data[2] : 0;
-            handleMIDI(metadata.data[0], data1, data2);
+            render(buffer, end - bufferOffset, bufferOffset);
+            bufferOffset = end;
         }
+
+        if (!changeDue) { break; }
+        applyParameterChanges(end);
     }
+}
 
-    // Rendering audio after last MIDI event or whole buffer if no events
-    int samplesLastSegment = buffer.getNumSamples() - bufferOffset;
-    if (samplesLastSegment > 0)
+// Only part 0 follows the preset parameters, so a change to one of those only has to update
+// that part. The shared parameters go through all parts.
+void JX11AudioProcessor::applyParameterChanges(int position)
+{
+    uint64_t dirty = 0;
+    while (nextChange < changeCount && pendingChanges[static_cast<size_t>(nextChange)].sampleOffset <= position)
     {
-        render(buffer, samplesLastSegment, bufferOffset);
+        const ParameterQueue::Change& change = pendingChanges[static_cast<size_t>(nextChange++)];
+        partParams[change.slot] = change.value;
+        dirty |= uint64_t(1) << change.slot;
     }
 
-    midiMessages.clear();
+    if (dirty != 0)
+    {
+        updateSlots(dirty);
+    }
 }
 
 void JX11AudioProcessor::handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2)
 {
-    // Program Change
+    // Program Change. In Multi mode the channels after the first switch their own part.
     if ((data0 & 0xF0) == 0xC0) {
         if (data1 < presets.size()) {
-            setCurrentProgram(data1);
+            int part = synth.isMultiTimbral() ? (data0 & 0x0F) : 0;
+            if (part == 0) {
+                applyProgram(data1);
+            } else {
+                partPrograms[part].store(data1);
+                partValues[static_cast<size_t>(part)] = midiProgramValues[data1];
+                updatePart(part, partValues[static_cast<size_t>(part)].data());
+            }
         }
     }
 
     synth.midiMessage(data0, data1, data2);
 }
 
+// Program Change for part 0 on the audio thread. Instead of going through the parameters it
+// plays the program's prepared values straight away, like the other parts do, and leaves
+// telling the host to timerCallback.
+void JX11AudioProcessor::applyProgram(int index) noexcept
+{
+    const ProgramValues& values = midiProgramValues[static_cast<size_t>(index)];
+    std::copy(values.begin(), values.end(), partParams);
+    partPrograms[0].store(index);
+    updatePart(0, partParams);
+    programToNotify.store(index);
+}
+
+// The values of a program as its parameters would hold them. Snapping to the parameter ranges
+// means a program change on the audio thread ends up with the same values as one made
+// through the parameters. A program of a bank file may have to come from disk, so the audio
+// thread never calls this.
+void JX11AudioProcessor::readProgramValues(int index, float* values) const
+{
+    presets.getParameters(index, values);
+    for (int slot = 0; slot < NUM_PARAMS; ++slot)
+    {
+        auto* parameter = slotParameters[static_cast<size_t>(slot)];
+        float value = parameter->convertFrom0to1(parameter->convertTo0to1(values[slot]));
+        values[slot] = slotChoices[static_cast<size_t>(slot)] != nullptr ? std::round(value) : value;
+    }
+}
+
+// Reads the programs the audio thread can switch to, which are at most MIDI_PROGRAMS and
+// those the parts and the morph play however large the bank is. Call it only while
+// processing is suspended or has not started.
+void JX11AudioProcessor::prepareProgramValues()
+{
+    midiProgramValues.resize(static_cast<size_t>(std::min(presets.size(), MIDI_PROGRAMS)));
+    for (size_t i = 0; i < midiProgramValues.size(); ++i)
+    {
+        readProgramValues(static_cast<int>(i), midiProgramValues[i].data());
+    }
+    for (int p = 1; p < Synth::NUM_PARTS; ++p)
+    {
+        readProgramValues(partPrograms[p].load(), partValues[static_cast<size_t>(p)].data());
+    }
+    readMorphValues();
+}
+
+void JX11AudioProcessor::readMorphValues()
+{
+    for (size_t i = 0; i < morphValues.size(); ++i)
+    {
+        int program = morphPrograms[i].load();
+        if (program >= 0 && program < presets.size())
+        {
+            readProgramValues(program, morphValues[i].data());
+        }
+    }
+}
+
+void JX11AudioProcessor::saveRenderState(RenderState& state) const
+{
+    synth.saveState(state.synth);
+    state.partParams.assign(std::begin(partParams), std::end(partParams));
+    for (int p = 0; p < Synth::NUM_PARTS; ++p)
+    {
+        state.partPrograms[p] = partPrograms[p].load();
+    }
+}
+
+bool JX11AudioProcessor::restoreRenderState(const RenderState& state)
+{
+    if (state.partParams.size() != NUM_SLOTS || !synth.restoreState(state.synth))
+    {
+        return false;
+    }
+
+    std::copy(state.partParams.begin(), state.partParams.end(), partParams);
+    for (int p = 0; p < Synth::NUM_PARTS; ++p)
+    {
+        partPrograms[p].store(state.partPrograms[p]);
+        if (p > 0) { readProgramValues(state.partPrograms[p], partValues[static_cast<size_t>(p)].data()); }
+    }
+
+    // The synth already plays what the parameters say.
+    ParameterQueue::Change change;
+    while (parameterQueue.pop(change)) { }
+    dirtySlots.store(0);
+    morphChanged.store(false);
+    return true;
+}
+
+bool JX11AudioProcessor::loadPresetBank(const juce::File& file)
+{
+    suspendProcessing(true);
+
+    bool loaded = true;
+    if (file == juce::File())
+    {
+        presets.useFactoryPresets();
+    }
+    else
+    {
+        loaded = presets.load(file);
+    }
+
+    // Programs past the end of the new bank start over at the first.
+    for (auto& program : partPrograms)
+    {
+        if (program.load() >= presets.size()) { program.store(0); }
+    }
+    prepareProgramValues();
+    if (currentProgram >= presets.size()) { currentProgram = 0; }
+    morphChanged.store(true);
+
+    suspendProcessing(false);
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+    return loaded;
+}
+
 void JX11AudioProcessor::render(juce::AudioBuffer<float>& buffer, int sampleCount, int bufferOffset)
 {
     float* outputBuffers[2] = { nullptr, nullptr };
@@ -342,116 +810,441 @@ void JX11AudioProcessor::render(juce::AudioBuffer<float>& buffer, int sampleCoun
         outputBuffers[1] = buffer.getWritePointer(1) + bufferOffset;
     }
 
+    JX11_MEASURE_LOAD(loadMeter, RENDER, sampleCount);
     synth.render(outputBuffers, sampleCount);
+    ++segmentCount;
 }
 
-void JX11AudioProcessor::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged,
-    const juce::Identifier& property)
+// Where the change belongs in the audio. Only setParameterAt moves it from the start of the
+// next block, for changes made on its own thread.
+static thread_local int changeOffset = 0;
+
+void JX11AudioProcessor::setParameterAt(juce::RangedAudioParameter& parameter, float normalizedValue, int sampleOffset)
 {
-   parametersChanged.store(true);
+    changeOffset = sampleOffset;
+    parameter.setValueNotifyingHost(normalizedValue);
+    changeOffset = 0;
 }
 
-void JX11AudioProcessor::update() noexcept
+// Called on whichever thread changed the parameter.
+void JX11AudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
 {
-    auto sampleRate = static_cast<float>(getSampleRate());
-    auto inverseSampleRate = 1.0f / sampleRate;
+    if (quietParameterChanges) { return; }
 
-    synth.envAttack = std::exp(-inverseSampleRate * std::exp(5.5f - 0.075f * params.envAttackParam->get()));
-    synth.envDecay = std::exp(-inverseSampleRate * std::exp(5.5f - 0.075f * params.envDecayParam->get()));
-    synth.envSustain = params.envSustainParam->get() / 100.0f;
+    int slot = parameterSlots[static_cast<size_t>(parameterIndex)];
+    float value = slotParameters[static_cast<size_t>(slot)]->convertFrom0to1(newValue);
 
-    float envRelease = params.envReleaseParam->get();
-    if (envRelease < 1.0f)
+    if (!parameterQueue.push({ changeOffset, slot, value }))
     {
-        synth.envRelease = 0.75f; // extra fast release
+        dirtySlots.fetch_or(uint64_t(1) << slot);  // too many changes at once, read it next block
     }
-    else
+}
+
+// Runs on the message thread. Only the latest program change is passed on, the host does not
+// need to hear of the ones before it.
+void JX11AudioProcessor::timerCallback()
+{
+    int interval = engineStatsInterval.load();
+    auto now = juce::Time::getMillisecondCounter();
+    if (interval > 0 && now - lastStatsDump >= static_cast<juce::uint32>(interval) * 1000)
     {
-        synth.envRelease = std::exp(-inverseSampleRate * std::exp(5.5f - 0.075f * envRelease));
+        lastStatsDump = now;
+        juce::Logger::writeToLog("JX11 " + getEngineStats().toString());
     }
 
-    float noiseMix = params.noiseParam->get() / 100.0f;
-    noiseMix *= noiseMix;
-    synth.noiseMix = noiseMix * 0.06f;
+    notifyProgramChange();
+}
 
-    synth.oscMix = params.oscMixParam->get() / 100.0f;
+void JX11AudioProcessor::notifyProgramChange()
+{
+    int index = programToNotify.exchange(-1);
+    if (index < 0 || index >= presets.size()) { return; }
 
-    float semi = params.oscTuneParam->get();
-    float cent = params.oscFineParam->get();
-    synth.detune = std::pow(1.059463094359f, -semi - 0.01f * cent);
+    currentProgram = index;
+    float values[NUM_PARAMS];
+    readProgramValues(index, values);
+    quietParameterChanges = true;
+    for (int slot = 0; slot < NUM_PARAMS; ++slot)
+    {
+        auto* parameter = slotParameters[static_cast<size_t>(slot)];
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(values[slot]));
+    }
+    quietParameterChanges = false;
 
-    float octave = params.octaveParam->get();
-    float tuning = params.tuningParam->get();
-    float tuneInSemi = -36.3763f - 12.0f * octave - tuning / 100.0f;
-    synth.tune = sampleRate * std::exp(0.05776226505f * tuneInSemi);
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+}
 
-    synth.prevNumVoices = synth.numVoices;
-    synth.numVoices = static_cast<int>(params.polyModeParam->get());
-    if (synth.numVoices != synth.prevNumVoices)
+// Reads the dirty parameters into partParams and updates what depends on them.
+void JX11AudioProcessor::update(uint64_t dirty) noexcept
+{
+    for (uint64_t bits = dirty; bits != 0; bits &= bits - 1)
     {
-        synth.releaseVoices();
+        int slot = std::countr_zero(bits);
+        auto* choice = slotChoices[static_cast<size_t>(slot)];
+        if (choice != nullptr)
+        {
+            partParams[slot] = static_cast<float>(choice->getIndex());
+        }
+        else
+        {
+            partParams[slot] = static_cast<juce::AudioParameterFloat*>(slotParameters[static_cast<size_t>(slot)])->get();
+        }
     }
 
-    synth.outputLevelSmoother.setTargetValue(juce::Decibels::decibelsToGain(params.outputLevelParam->get()));
+    updateSlots(dirty);
+}
 
-    float filterVelocity = params.filterVelocityParam->get();
-    if (filterVelocity < -90.0f)
+// Runs the update function of every dirty slot for part 0, and those of the shared slots
+// for the other parts as well.
+void JX11AudioProcessor::updateSlots(uint64_t dirty) noexcept
+{
+    // Switching the MIDI mode sets every part up from scratch.
+    if ((dirty & (uint64_t(1) << midiModeSlot)) != 0)
     {
-        synth.velocitySensitivity = 0.0f;
-        synth.ignoreVelocity = true;
+        updateParts();
+        return;
     }
-    else
+
+    for (uint64_t bits = dirty; bits != 0; bits &= bits - 1)
     {
-        synth.velocitySensitivity = 0.0005f * filterVelocity;
-        synth.ignoreVelocity = false;
+        parameterUpdates[std::countr_zero(bits)](*this, 0, partParams);
     }
 
-    const float inverseUpdateRate = inverseSampleRate * synth.LFO_MAX;
-    float lfoRate = std::exp(7.0f * params.lfoRateParam->get() - 4.0f);
-    synth.lfoInc = lfoRate * inverseUpdateRate * static_cast<float>(TWO_PI);
+    uint64_t shared = dirty >> NUM_PARAMS << NUM_PARAMS;
+    if (shared != 0 && synth.isMultiTimbral())
+    {
+        for (int p = 1; p < Synth::NUM_PARTS; ++p)
+        {
+            for (uint64_t bits = shared; bits != 0; bits &= bits - 1)
+            {
+                parameterUpdates[std::countr_zero(bits)](*this, p, partValues[static_cast<size_t>(p)].data());
+            }
+        }
+    }
+}
 
-    synth.glideMode = params.glideModeParam->getIndex();
-    float glideRate = params.glideRateParam->get();
-    if (glideRate < 2.0f)
+void JX11AudioProcessor::updateParts() noexcept
+{
+    synth.setMultiTimbral(static_cast<int>(partParams[midiModeSlot]) == 1);
+    updatePart(0, partParams);
+
+    // The other parts play their programs as the parameters would hold them.
+    if (synth.isMultiTimbral())
     {
-        synth.glideRate = 1.0f;
+        for (int p = 1; p < Synth::NUM_PARTS; ++p)
+        {
+            updatePart(p, partValues[static_cast<size_t>(p)].data());
+        }
     }
-    else
+}
+
+void JX11AudioProcessor::updatePart(int p, const float* param) noexcept
+{
+    // oscTune and octave already work out what oscFine and tuning would.
+    for (int slot = 0; slot < midiModeSlot; ++slot)
     {
-        synth.glideRate = 1.0f - std::exp(-inverseUpdateRate * std::exp(6.0f - 0.07f * glideRate));
+        if (slot != PresetParam::oscFine && slot != PresetParam::tuning)
+        {
+            parameterUpdates[slot](*this, p, param);
+        }
     }
 
-    synth.glideBend = params.glideBendParam->get();
+    // A new patch starts right away.
+    Synth::Part& part = synth.parts[p];
+    part.smoothing.finish();
+    part.noiseMixSmoother.setCurrentAndTargetValue(part.noiseMix);
+}
 
-    float vibrato = params.vibratoParam->get() / 200.0f;
-    synth.vibrato = 0.2f * vibrato * vibrato;
+// volumeTrim makes up for the level of the oscillators, the noise and the resonance.
+static void updateVolumeTrim(Synth::Part& part, const float* param)
+{
+    float filterReso = param[PresetParam::filterReso] / 100.0f;
+    part.volumeTrim = 0.0008f * (3.2f - part.oscMix - 25.0f * part.noiseMix) * (1.5f - 0.5f * filterReso);
+}
 
-    synth.pwmDepth = synth.vibrato;
-    if (vibrato < 0.0f) { synth.vibrato = 0.0f;}
+static float envelopeMultiplier(float inverseRate, float value)
+{
+    return std::exp(-inverseRate * std::exp(5.5f - 0.075f * value));
+}
 
-    synth.lfoWave = params.lfoWaveformParam->getIndex();
-    synth.filterKeyTracking = 0.08f * params.filterFreqParam->get() - 1.5f;
+// One entry per slot, each working out the synth values that depend on that parameter.
+// The shared parameters are the same for every part and come from the processor.
+const JX11AudioProcessor::ParameterUpdate JX11AudioProcessor::parameterUpdates[NUM_SLOTS] =
+{
+    // oscMix
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        part.oscMix = param[PresetParam::oscMix] / 100.0f;
+        updateVolumeTrim(part, param);
+    },
+    // oscTune
+    [](JX11AudioProcessor& processor, int p, const float* param) { processor.updateDetune(p, param); },
+    // oscFine
+    [](JX11AudioProcessor& processor, int p, const float* param) { processor.updateDetune(p, param); },
+    // glideMode
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).glideMode = static_cast<int>(param[PresetParam::glideMode]);
+    },
+    // glideRate
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        float glideRate = param[PresetParam::glideRate];
+        if (glideRate < 2.0f)
+        {
+            processor.updatedPart(p).glideRate = 1.0f;
+        }
+        else
+        {
+            processor.updatedPart(p).glideRate = 1.0f - std::exp(-processor.inverseUpdateRate() * std::exp(6.0f - 0.07f * glideRate));
+        }
+    },
+    // glideBend
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).glideBend = param[PresetParam::glideBend];
+    },
+    // filterFreq
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        part.smoothing.rampLinear(part.filterKeyTracking, 0.08f * param[PresetParam::filterFreq] - 1.5f);
+    },
+    // filterReso
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        float filterReso = param[PresetParam::filterReso] / 100.0f;
+        part.smoothing.rampExponential(part.filterQ, std::exp(3.0f * filterReso));
+        updateVolumeTrim(part, param);
+    },
+    // filterEnv
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        part.smoothing.rampLinear(part.filterEnvDepth, 0.06f * param[PresetParam::filterEnv]);
+    },
+    // filterLFO
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        float filterLFO = param[PresetParam::filterLFO] / 100.0f;
+        part.smoothing.rampLinear(part.filterLFODepth, 2.5f * filterLFO * filterLFO);
+    },
+    // filterVelocity
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        float filterVelocity = param[PresetParam::filterVelocity];
+        if (filterVelocity < -90.0f)
+        {
+            part.velocitySensitivity = 0.0f;
+            part.ignoreVelocity = true;
+        }
+        else
+        {
+            part.velocitySensitivity = 0.0005f * filterVelocity;
+            part.ignoreVelocity = false;
+        }
+    },
+    // filterAttack
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).filterAttack = envelopeMultiplier(processor.inverseUpdateRate(), param[PresetParam::filterAttack]);
+    },
+    // filterDecay
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).filterDecay = envelopeMultiplier(processor.inverseUpdateRate(), param[PresetParam::filterDecay]);
+    },
+    // filterSustain
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        float filterSustain = param[PresetParam::filterSustain] / 100.0f;
+        processor.updatedPart(p).filterSustain = filterSustain * filterSustain;
+    },
+    // filterRelease
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).filterRelease = envelopeMultiplier(processor.inverseUpdateRate(), param[PresetParam::filterRelease]);
+    },
+    // envAttack
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).envAttack = envelopeMultiplier(processor.inverseSampleRate(), param[PresetParam::envAttack]);
+    },
+    // envDecay
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).envDecay = envelopeMultiplier(processor.inverseSampleRate(), param[PresetParam::envDecay]);
+    },
+    // envSustain
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).envSustain = param[PresetParam::envSustain] / 100.0f;
+    },
+    // envRelease
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        float envRelease = param[PresetParam::envRelease];
+        if (envRelease < 1.0f)
+        {
+            processor.updatedPart(p).envRelease = 0.75f; // extra fast release
+        }
+        else
+        {
+            processor.updatedPart(p).envRelease = envelopeMultiplier(processor.inverseSampleRate(), envRelease);
+        }
+    },
+    // lfoRate
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        float lfoRate = std::exp(7.0f * param[PresetParam::lfoRate] - 4.0f);
+        processor.updatedPart(p).lfoInc = lfoRate * processor.inverseUpdateRate() * static_cast<float>(TWO_PI);
+    },
+    // vibrato
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        float vibrato = param[PresetParam::vibrato] / 200.0f;
+        float depth = 0.2f * vibrato * vibrato;
+
+        // Negative values are PWM without vibrato.
+        part.smoothing.rampLinear(part.pwmDepth, depth);
+        part.smoothing.rampLinear(part.vibrato, vibrato < 0.0f ? 0.0f : depth);
+    },
+    // noise
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        Synth::Part& part = processor.updatedPart(p);
+        float noiseMix = param[PresetParam::noise] / 100.0f;
+        noiseMix *= noiseMix;
+        part.noiseMix = noiseMix * 0.06f;
+        part.noiseMixSmoother.setTargetValue(part.noiseMix);
+        updateVolumeTrim(part, param);
+    },
+    // octave
+    [](JX11AudioProcessor& processor, int p, const float* param) { processor.updateTune(p, param); },
+    // tuning
+    [](JX11AudioProcessor& processor, int p, const float* param) { processor.updateTune(p, param); },
+    // outputLevel
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        processor.updatedPart(p).outputLevelSmoother.setTargetValue(juce::Decibels::decibelsToGain(param[PresetParam::outputLevel]));
+    },
+    // polyMode
+    [](JX11AudioProcessor& processor, int p, const float* param)
+    {
+        // Presets store mono as 0, the parameter as 1.
+        Synth::Part& part = processor.updatedPart(p);
+        part.prevNumVoices = part.numVoices;
+        part.numVoices = juce::jlimit(1, Synth::MAX_VOICES, static_cast<int>(param[PresetParam::polyMode]));
+        if (part.numVoices != part.prevNumVoices)
+        {
+            processor.synth.releaseVoices(p);
+        }
+    },
+    // oscEngine
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).oscEngine = static_cast<Synth::OscEngine>(processor.partParams[oscEngineSlot]);
+    },
+    // lfoWaveform
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).lfoWave = static_cast<int>(processor.partParams[lfoWaveformSlot]);
+    },
+    // filterRate
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).filterRate = static_cast<Synth::FilterRate>(processor.partParams[filterRateSlot]);
+    },
+    // unison
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).unison = static_cast<int>(processor.partParams[unisonSlot]);
+    },
+    // unisonDetune, at full detune the outermost copies are a semitone away from the note
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        float unisonDetune = processor.partParams[unisonDetuneSlot] / 100.0f;
+        processor.updatedPart(p).unisonDetune = unisonDetune * unisonDetune;
+    },
+    // unisonSpread
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).unisonSpread = processor.partParams[unisonSpreadSlot] / 100.0f;
+    },
+    // morph
+    [](JX11AudioProcessor& processor, int p, const float*)
+    {
+        processor.updatedPart(p).morphAmount = processor.partParams[morphSlot] / 100.0f;
+    },
+    // midiMode, handled by updateSlots
+    [](JX11AudioProcessor&, int, const float*) { },
+};
 
-    float filterReso = params.filterResoParam->get() / 100.0f;
-    synth.filterQ = std::exp(3.0f * filterReso);
+void JX11AudioProcessor::setMorphPrograms(int programA, int programB)
+{
+    suspendProcessing(true);
+    morphPrograms[0].store(programA);
+    morphPrograms[1].store(programB);
+    readMorphValues();
+    morphChanged.store(true);
+    suspendProcessing(false);
+}
 
-    synth.volumeTrim = 0.0008f * (3.2f - synth.oscMix - 25.0f * synth.noiseMix) * (1.5f - 0.5f * filterReso);
+// Works out the patch values of both programs once, so that a morph only has to mix them.
+void JX11AudioProcessor::prepareMorph() noexcept
+{
+    Synth::Part& part = synth.parts[0];
+    int programA = morphPrograms[0].load();
+    int programB = morphPrograms[1].load();
 
-    float filterLFO = params.filterLFOParam->get() / 100.0f;
-    synth.filterLFODepth = 2.5f * filterLFO * filterLFO;
+    if (programA < 0 || programA >= getNumPrograms() || programB < 0 || programB >= getNumPrograms())
+    {
+        if (part.morphing)
+        {
+            part.morphing = false;
+            updatePart(0, partParams);
+        }
+        return;
+    }
 
-    synth.filterAttack = std::exp(-inverseUpdateRate *
-        std::exp(5.5f - 0.075f * params.filterAttackParam->get()));
-    synth.filterDecay = std::exp(-inverseUpdateRate *
-        std::exp(5.5f - 0.075f * params.filterDecayParam->get()));
+    capturePatch(morphValues[0].data(), part.morphA);
+    capturePatch(morphValues[1].data(), part.morphB);
+    part.morphing = true;
+    part.morphMixed = -1.0f;
+}
 
-    float filterSustain = params.filterSustainParam->get() / 100.0f;
+void JX11AudioProcessor::capturePatch(const float* param, PatchValues& values) noexcept
+{
+    // Polyphony is not part of a morph. oscTune and octave cover oscFine and tuning.
+    for (int slot = 0; slot < NUM_PARAMS; ++slot)
+    {
+        if (slot != PresetParam::polyMode && slot != PresetParam::oscFine && slot != PresetParam::tuning)
+        {
+            parameterUpdates[slot](*this, PATCH_PART, param);
+        }
+    }
+    Synth::capturePatch(patchPart, values);
+}
 
-    synth.filterSustain = filterSustain * filterSustain;
-    synth.filterRelease = std::exp(-inverseUpdateRate *
-        std::exp(5.5f - 0.075f * params.filterReleaseParam->get()));
+void JX11AudioProcessor::updateDetune(int p, const float* param) noexcept
+{
+    float semi = param[PresetParam::oscTune];
+    float cent = param[PresetParam::oscFine];
+    Synth::Part& part = updatedPart(p);
+    part.smoothing.rampExponential(part.detune, std::pow(1.059463094359f, -semi - 0.01f * cent));
+}
 
-    synth.filterEnvDepth = 0.06f * params.filterEnvParam->get();
+void JX11AudioProcessor::updateTune(int p, const float* param) noexcept
+{
+    float octave = param[PresetParam::octave];
+    float tuning = param[PresetParam::tuning];
+    float tuneInSemi = -36.3763f - 12.0f * octave - tuning / 100.0f;
+    updatedPart(p).tune = static_cast<float>(getSampleRate()) * std::exp(0.05776226505f * tuneInSemi);
 }
 
 //==============================================================================
@@ -11,13 +11,17 @@
 #include <JuceHeader.h>
 #include "Parameters.h"
 #include "Synth.h"
-#include "Preset.h"
+#include "PresetBank.h"
+#include "SavedState.h"
+#include "ParameterQueue.h"
+#include "LoadMeter.h"
 
 //==============================================================================
 /**
 */
 class JX11AudioProcessor : public juce::AudioProcessor,
-                           private juce::ValueTree::Listener
+                           private juce::AudioProcessorParameter::Listener,
+                           private juce::Timer
 {
 public:
     //==============================================================================
@@ -60,20 +64,199 @@ public:
 
     juce::AudioProcessorValueTreeState apvts { *this, nullptr, "Parameters", Parameters::createParameterLayout() };
 
+    // Which of the synth's render paths plays, and on how many worker threads, for tools that
+    // compare them. Call them before prepareToPlay.
+    void setRenderMode(Synth::RenderMode mode) { synth.renderMode = mode; }
+    void setRenderThreads(int threads) { synth.renderThreads = threads; }
+
+    // Sets a parameter as if it moved sampleOffset samples into the next processBlock call,
+    // for callers that know where in the audio a change belongs.
+    void setParameterAt(juce::RangedAudioParameter& parameter, float normalizedValue, int sampleOffset);
+
+    // Controller messages that only set a value, such as pitch bend, pressure or the mod
+    // wheel, are merged within windows of this many samples: each controller keeps its last
+    // value, applied where the last of them came in. Notes stay where they are. The default
+    // is one control tick, so the values read only at the tick come out unchanged. The synth
+    // works out a few things at every cut in the block, such as the oscillator periods of a
+    // glide, so the output is that of the script with only the last message of each window
+    // sent, not bit for bit that of all of them. 1 merges only messages on the same sample,
+    // 0 turns merging off.
+    int controllerWindow = Synth::LFO_MAX;
+
+    // How finely the blocks were cut up for the MIDI events and parameter changes.
+    std::atomic<int> segmentsInLastBlock { 0 };
+    std::atomic<int> mostSegmentsInABlock { 0 };
+    std::atomic<uint64_t> mergedControllers { 0 };  // controller messages left out by merging
+
+    // What the engine did since the last reset, for sizing the polyphony to a rig from what
+    // it actually plays. Any thread may read or reset it.
+    struct EngineStats
+    {
+        uint64_t blocks = 0;
+        uint64_t samples = 0;
+        double averageVoices = 0.0;  // active voices, averaged over the samples
+        int peakVoices = 0;
+        uint64_t voiceSteals = 0;
+        uint64_t monoShifts = 0;
+        uint64_t voiceEnds = 0;        // voices whose envelope ran out
+        double averageSegments = 0.0;  // render segments per block
+        int mostSegments = 0;
+        uint64_t silentBlocks = 0;     // blocks that came out all zeros
+        uint64_t clippedSamples = 0;   // samples past full scale
+        uint64_t silencedSamples = 0;  // samples the debug build's guard cleared
+
+        juce::String toString() const;
+    };
+    EngineStats getEngineStats() const;
+    void resetEngineStats();
+
+    // Writes the engine stats to the JUCE logger every this many seconds, 0 for never.
+    std::atomic<int> engineStatsInterval { 0 };
+
+#if JX11_LOAD_METER
+    // How close the audio thread comes to its deadline. Any thread may read or reset it.
+    LoadMeter loadMeter;
+#endif
+
+    // Part 0 morphs from program A to program B by the Morph parameter or the synth's morph
+    // controller. -1 for either goes back to playing the parameters. It reads the programs
+    // from the bank, so call it from any thread but the audio thread.
+    void setMorphPrograms(int programA, int programB);
+
+    // Sets the parameters to the program a MIDI Program Change switched part 0 to, and tells
+    // the host. The timer calls it on the message thread; a tool without a message loop can
+    // call it itself.
+    void notifyProgramChange();
+
+    // What the audio thread carries from one block to the next: the synth's DSP state and the
+    // patches that MIDI program changes switched to. A processor set up the same way that
+    // restores it between processBlock calls carries on exactly where it was saved, which
+    // lets an offline render do a timeline in pieces. Parameter changes it has not applied
+    // yet are dropped. Neither call is real-time safe.
+    struct RenderState
+    {
+        Synth::State synth;
+        std::vector<float> partParams;
+        std::array<int, Synth::NUM_PARTS> partPrograms;
+    };
+    void saveRenderState(RenderState& state) const;
+    bool restoreRenderState(const RenderState& state);
+
+    // Takes the programs from a bank file instead of the factory presets, or goes back to
+    // those for an empty File. Returns false if the file is not a bank.
+    bool loadPresetBank(const juce::File& file);
 
 private:
+    // Every parameter has a slot: first the ones stored in presets, in preset order, then
+    // the ones shared by all parts. The dirty mask has a bit per slot.
+    enum
+    {
+        oscEngineSlot = NUM_PARAMS,
+        lfoWaveformSlot,
+        filterRateSlot,
+        unisonSlot,
+        unisonDetuneSlot,
+        unisonSpreadSlot,
+        morphSlot,
+        midiModeSlot,
+        NUM_SLOTS
+    };
+    static_assert(NUM_SLOTS <= 64, "the dirty mask has a bit per slot");
+    static constexpr uint64_t ALL_SLOTS = (uint64_t(1) << NUM_SLOTS) - 1;
+
+    // Works out the synth values that depend on one slot, for part p with its preset values.
+    using ParameterUpdate = void (*)(JX11AudioProcessor& processor, int p, const float* param);
+    static const ParameterUpdate parameterUpdates[NUM_SLOTS];
+
     Parameters params;
     Synth synth;
-    std::atomic<bool> parametersChanged{ false };
-    std::vector<Preset> presets;
+    std::atomic<uint64_t> dirtySlots{ 0 };        // slots to read again at the next block
+    std::array<juce::RangedAudioParameter*, NUM_SLOTS> slotParameters;
+    std::array<juce::AudioParameterChoice*, NUM_SLOTS> slotChoices;  // null for the float parameters
+    std::vector<int> parameterSlots;              // per parameter index, its slot
+    float partParams[NUM_SLOTS] {};               // what part 0 plays with, by slot
+
+    // The update functions write to synth.parts[p], or to patchPart for PATCH_PART, where
+    // capturePatch works out what a program plays like without touching a sounding part.
+    static constexpr int PATCH_PART = Synth::NUM_PARTS;
+    Synth::Part patchPart {};
+    Synth::Part& updatedPart(int p) noexcept { return p == PATCH_PART ? patchPart : synth.parts[p]; }
+
+    std::array<std::atomic<int>, 2> morphPrograms { -1, -1 };
+    std::atomic<bool> morphChanged { false };  // set up the morph at the next block
+
+    // Parameter changes are applied at their position in the block, between the MIDI events.
+    ParameterQueue parameterQueue;
+    std::array<ParameterQueue::Change, ParameterQueue::CAPACITY> pendingChanges;
+    int changeCount = 0;
+    int nextChange = 0;
+
+    // Controller messages held back until their window ends, in the order of their last
+    // message, so the values come out as if every message had been handled.
+    static constexpr int MAX_HELD_CONTROLLERS = 32;
+    struct HeldController
+    {
+        uint8_t data0, data1, data2;
+    };
+    std::array<HeldController, MAX_HELD_CONTROLLERS> heldControllers;
+    int heldCount = 0;
+    int heldPosition = 0;  // where the held values are applied
+    int segmentCount = 0;
+
+    // The processor's part of the engine stats, counted by the audio thread like Synth::Stats.
+    std::atomic<uint64_t> blockCount { 0 };
+    std::atomic<uint64_t> totalSegments { 0 };
+    std::atomic<uint64_t> silentBlocks { 0 };
+    std::atomic<uint64_t> clippedSamples { 0 };
+    std::atomic<uint64_t> silencedSamples { 0 };
+    std::atomic<bool> statsResetRequested { false };
+    juce::uint32 lastStatsDump = 0;
+
+    // The audio thread never reads the bank, which may have to come from disk. It plays the
+    // values of the programs MIDI Program Change can reach, and those of the programs the
+    // parts and the morph play, read while it is suspended.
+    static constexpr int MIDI_PROGRAMS = 128;
+    using ProgramValues = std::array<float, NUM_PARAMS>;
+    PresetBank presets;
+    std::vector<ProgramValues> midiProgramValues;           // the first MIDI_PROGRAMS of the bank
+    std::array<ProgramValues, Synth::NUM_PARTS> partValues; // part 0 plays partParams instead
+    std::array<ProgramValues, 2> morphValues;
     int currentProgram;
+    std::atomic<int> programToNotify { -1 };  // the last program change the host has not heard of, or -1
+    std::array<std::atomic<int>, Synth::NUM_PARTS> partPrograms {};  // the preset of each part in Multi mode
+
+    // The header and parameter ID table that begin every saved state.
+    juce::MemoryBlock stateHeader;
 
-    void createPrograms();
+    void makeStateHeader();
+    void readParameters(const SavedState& state);
+    void restoreSettings(const juce::String& bankPath, const int* programs, int programCount, int morphA, int morphB);
     void splitBufferByEvents(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+    void collectParameterChanges(int sampleCount);
+    void renderUpTo(juce::AudioBuffer<float>& buffer, int position, int& bufferOffset);
+    void holdController(uint8_t data0, uint8_t data1, uint8_t data2, int position);
+    void releaseControllers(juce::AudioBuffer<float>& buffer, int& bufferOffset);
+    void applyParameterChanges(int position);
     void handleMIDI(uint8_t data0, uint8_t data1, uint8_t data2);
+    void applyProgram(int index) noexcept;
+    void readProgramValues(int index, float* values) const;
+    void prepareProgramValues();
+    void readMorphValues();
+    void timerCallback() override;
+    void countOutput(const juce::AudioBuffer<float>& buffer) noexcept;
     void render(juce::AudioBuffer<float>& buffer, int sampleCount, int bufferOffset);
-    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
-    void update() noexcept;
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int, bool) override { }
+    void update(uint64_t dirty) noexcept;
+    void updateSlots(uint64_t dirty) noexcept;
+    void updateParts() noexcept;
+    void updatePart(int part, const float* param) noexcept;
+    void updateDetune(int part, const float* param) noexcept;
+    void updateTune(int part, const float* param) noexcept;
+    void prepareMorph() noexcept;
+    void capturePatch(const float* param, PatchValues& values) noexcept;
+    float inverseSampleRate() const noexcept { return 1.0f / static_cast<float>(getSampleRate()); }
+    float inverseUpdateRate() const noexcept { return inverseSampleRate() * Synth::LFO_MAX; }
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JX11AudioProcessor)
 };
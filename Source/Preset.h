@@ -1,19 +1,37 @@
 #pragma once
-#include <cstring>
 const int NUM_PARAMS = 26;
 
+// Where each parameter sits in Preset::param.
+namespace PresetParam
+{
+    enum
+    {
+        oscMix, oscTune, oscFine, glideMode, glideRate, glideBend,
+        filterFreq, filterReso, filterEnv, filterLFO, filterVelocity,
+        filterAttack, filterDecay, filterSustain, filterRelease,
+        envAttack, envDecay, envSustain, envRelease,
+        lfoRate, vibrato, noise, octave, tuning, outputLevel, polyMode
+    };
+}
+
 struct Preset
 {
-    Preset(const char* name,
+    static constexpr int NAME_SIZE = 40;
+
+    Preset() = default;
+    constexpr Preset(const char* name,
     float p0, float p1, float p2, float p3,
     float p4, float p5, float p6, float p7,
     float p8, float p9, float p10, float p11,
     float p12, float p13, float p14, float p15,
     float p16, float p17, float p18, float p19,
     float p20, float p21, float p22, float p23,
-    float p24, float p25)
+    float p24, float p25) : name{}, param{}
     {
-        strcpy(this->name, name);
+        for (int i = 0; i < NAME_SIZE - 1 && name[i] != '\0'; ++i)
+        {
+            this->name[i] = name[i];
+        }
         param[0] = p0; // Osc Mix
         param[1] = p1; // Osc Tune
         param[2] = p2; // Osc Fine
@@ -41,6 +59,6 @@ struct Preset
         param[24] = p24; // Output Level
         param[25] = p25; // Polyphony
     }
-    char name[40];
+    char name[NAME_SIZE];
     float param[NUM_PARAMS];
 };
@@ -0,0 +1,153 @@
+#include "PresetBank.h"
+#include "FactoryPresets.h"
+#include "Parameters.h"
+#include <cstring>
+#include <limits>
+
+static constexpr char MAGIC[8] = { 'J', 'X', '1', '1', 'B', 'A', 'N', 'K' };
+
+// The parameters in the order of Preset::param.
+static const juce::ParameterID* const presetParameterIDs[NUM_PARAMS] =
+{
+    &ParameterID::oscMix, &ParameterID::oscTune, &ParameterID::oscFine,
+    &ParameterID::glideMode, &ParameterID::glideRate, &ParameterID::glideBend,
+    &ParameterID::filterFreq, &ParameterID::filterReso, &ParameterID::filterEnv,
+    &ParameterID::filterLFO, &ParameterID::filterVelocity,
+    &ParameterID::filterAttack, &ParameterID::filterDecay, &ParameterID::filterSustain, &ParameterID::filterRelease,
+    &ParameterID::envAttack, &ParameterID::envDecay, &ParameterID::envSustain, &ParameterID::envRelease,
+    &ParameterID::lfoRate, &ParameterID::vibrato, &ParameterID::noise, &ParameterID::octave,
+    &ParameterID::tuning, &ParameterID::outputLevel, &ParameterID::polyMode,
+};
+
+static uint32_t readUInt32(const uint8_t* data)
+{
+    return juce::ByteOrder::littleEndianInt(data);
+}
+
+static float readFloat32(const uint8_t* data)
+{
+    uint32_t bits = readUInt32(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+PresetBank::PresetBank()
+{
+    useFactoryPresets();
+}
+
+void PresetBank::useFactoryPresets()
+{
+    file = juce::File();
+    mappedFile.reset();
+    presets = factoryPresets;
+    records = nullptr;
+    count = NUM_FACTORY_PRESETS;
+    paramCount = NUM_PARAMS;
+    recordSize = 0;
+}
+
+bool PresetBank::load(const juce::File& bankFile)
+{
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(bankFile, juce::MemoryMappedFile::readOnly);
+    auto* data = static_cast<const uint8_t*>(mapped->getData());
+    size_t size = mapped->getSize();
+    if (data == nullptr || size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        return false;
+    }
+
+    uint32_t version = readUInt32(data + 8);
+    uint32_t presetCount = readUInt32(data + 12);
+    uint32_t parameters = readUInt32(data + 16);
+    uint32_t bytesPerRecord = readUInt32(data + 20);
+    if (version == 0 || version > VERSION
+        || parameters > 1024
+        || bytesPerRecord < Preset::NAME_SIZE + 4 * parameters
+        || presetCount == 0
+        || presetCount > static_cast<uint32_t>(std::numeric_limits<int>::max())
+        || (size - HEADER_SIZE) / bytesPerRecord < presetCount)
+    {
+        return false;
+    }
+
+    file = bankFile;
+    mappedFile = std::move(mapped);
+    presets = nullptr;
+    records = data + HEADER_SIZE;
+    count = static_cast<int>(presetCount);
+    paramCount = static_cast<int>(parameters);
+    recordSize = static_cast<int>(bytesPerRecord);
+    return true;
+}
+
+juce::String PresetBank::getName(int index) const
+{
+    const char* name = presets != nullptr ? presets[index].name
+                                          : reinterpret_cast<const char*>(records + static_cast<size_t>(index) * static_cast<size_t>(recordSize));
+    size_t length = 0;
+    while (length < Preset::NAME_SIZE && name[length] != '\0') { ++length; }
+    return juce::String::fromUTF8(name, static_cast<int>(length));
+}
+
+void PresetBank::getParameters(int index, float* param) const
+{
+    if (presets != nullptr)
+    {
+        std::copy(presets[index].param, presets[index].param + NUM_PARAMS, param);
+        return;
+    }
+
+    const uint8_t* record = records + static_cast<size_t>(index) * static_cast<size_t>(recordSize) + Preset::NAME_SIZE;
+    int stored = std::min(paramCount, NUM_PARAMS);
+    for (int i = 0; i < stored; ++i)
+    {
+        param[i] = readFloat32(record + 4 * i);
+    }
+    std::copy(factoryPresets[0].param + stored, factoryPresets[0].param + NUM_PARAMS, param + stored);
+}
+
+bool PresetBank::write(juce::OutputStream& output, const Preset* presetsToWrite, int presetCount)
+{
+    bool ok = output.write(MAGIC, sizeof(MAGIC))
+           && output.writeInt(static_cast<int>(VERSION))
+           && output.writeInt(presetCount)
+           && output.writeInt(NUM_PARAMS)
+           && output.writeInt(Preset::NAME_SIZE + 4 * NUM_PARAMS);
+
+    for (int i = 0; ok && i < presetCount; ++i)
+    {
+        // Zero padded, with at least one zero at the end.
+        char name[Preset::NAME_SIZE] = {};
+        std::strncpy(name, presetsToWrite[i].name, Preset::NAME_SIZE - 1);
+        ok = output.write(name, sizeof(name));
+
+        for (int p = 0; ok && p < NUM_PARAMS; ++p)
+        {
+            ok = output.writeFloat(presetsToWrite[i].param[p]);
+        }
+    }
+    return ok;
+}
+
+// Parameters the state does not have come from the Init preset.
+Preset PresetBank::fromState(const SavedState& state, const juce::String& name)
+{
+    Preset preset = factoryPresets[0];
+    std::memset(preset.name, 0, sizeof(preset.name));
+    name.copyToUTF8(preset.name, Preset::NAME_SIZE);
+
+    for (const auto& [id, value] : state.getParameters())
+    {
+        for (int p = 0; p < NUM_PARAMS; ++p)
+        {
+            if (id == presetParameterIDs[p]->getParamID())
+            {
+                preset.param[p] = value;
+                break;
+            }
+        }
+    }
+    return preset;
+}
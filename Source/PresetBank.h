@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Preset.h"
+#include "SavedState.h"
+
+// The presets the plugin offers as programs: the factory set, or a bank file.
+//
+// A bank file is a header followed by fixed size records, all little endian:
+//
+//     char[8]   "JX11BANK"
+//     uint32    version
+//     uint32    number of presets
+//     uint32    parameters per preset
+//     uint32    bytes per record
+//     records:  char[40] name, UTF-8 and zero padded, then one float32 per parameter in
+//               PresetParam order
+//
+// The file is memory mapped and a preset is only read when it is asked for. Records with fewer parameters than this
+// version knows about get the rest from the Init preset, longer ones are read in part.
+class PresetBank
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int HEADER_SIZE = 24;
+
+    // Starts out with the factory presets.
+    PresetBank();
+
+    // Maps a bank file. Returns false, and keeps the presets it had, if the file is not a bank.
+    bool load(const juce::File& file);
+    void useFactoryPresets();
+
+    const juce::File& getFile() const { return file; }
+    int size() const { return count; }
+    juce::String getName(int index) const;
+
+    // The NUM_PARAMS plain parameter values of a preset. A preset of a bank file that has not
+    // been read in a while may have to come from disk first, so keep it off the audio thread.
+    void getParameters(int index, float* param) const;
+
+    // Writes presets as a bank file.
+    static bool write(juce::OutputStream& output, const Preset* presets, int presetCount);
+
+    // Makes a preset out of a state saved by getStateInformation.
+    static Preset fromState(const SavedState& state, const juce::String& name);
+
+private:
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    const Preset* presets;      // the factory presets, or null for a bank file
+    const uint8_t* records;
+    int count;
+    int paramCount;
+    int recordSize;
+
+    JUCE_DECLARE_NON_COPYABLE(PresetBank)
+};
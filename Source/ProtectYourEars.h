@@ -2,9 +2,9 @@
 
 #include <JuceHeader.h>
 
-// Silences the buffer if bad or loud values are detected in the output buffer.
-// Use this during debugging to avoid blowing out your eardrums on headphones.
-inline void protectYourEars(juce::AudioBuffer<float>& buffer)
+// Silences the buffer if bad or loud values are detected in the output buffer, and returns
+// whether it did. Use this during debugging to avoid blowing out your eardrums on headphones.
+inline bool protectYourEars(juce::AudioBuffer<float>& buffer)
 {
     bool firstWarning = true;
     for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
@@ -29,8 +29,9 @@ inline void protectYourEars(juce::AudioBuffer<float>& buffer)
             }
             if (silence) {
                 buffer.clear();
-                return;
+                return true;
             }
         }
     }
+    return false;
 }
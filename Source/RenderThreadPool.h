@@ -0,0 +1,166 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// A fixed set of real-time worker threads that help the audio thread through a list of
+// independent work items, such as the voices of one sub-block.
+//
+// The items of a job are handed out through one atomic word holding the item count and the
+// next unclaimed item, so whoever is free takes the next one. The audio thread takes items
+// as well and then waits for the last one to finish. Nothing on that path locks or allocates.
+//
+// Between jobs a worker yields for a while before it parks, since the next sub-block's job
+// usually comes right after. The audio thread only wakes workers when one has parked, so a
+// run of sub-blocks costs no system calls.
+class RenderThreadPool
+{
+public:
+    using Job = void (*)(void* context, int item);
+
+    static constexpr int MAX_ITEMS = 0xFFFF;
+
+    ~RenderThreadPool()
+    {
+        stop();
+    }
+
+    // Starts threadCount workers, replacing any that were running. Not real-time safe.
+    void start(int threadCount)
+    {
+        stop();
+        for (int i = 0; i < threadCount; ++i)
+        {
+            workers.push_back(std::make_unique<Worker>(*this));
+            workers.back()->startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(10));
+        }
+    }
+
+    void stop()
+    {
+        for (auto& worker : workers)
+        {
+            worker->signalThreadShouldExit();
+        }
+        jobCounter.fetch_add(1, std::memory_order_release);
+        jobCounter.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker->stopThread(1000);
+        }
+        workers.clear();
+    }
+
+    int getNumThreads() const { return static_cast<int>(workers.size()); }
+
+    // Calls job(context, item) once for every item below itemCount and returns when all of
+    // them are done. The calls may happen on any thread and in any order.
+    void run(Job job, void* context, int itemCount)
+    {
+        jassert(itemCount <= MAX_ITEMS);
+
+        if (workers.empty() || itemCount < 2)
+        {
+            for (int item = 0; item < itemCount; ++item)
+            {
+                job(context, item);
+            }
+            return;
+        }
+
+        currentJob = job;
+        currentContext = context;
+        finished.store(0, std::memory_order_relaxed);
+        claim.store(static_cast<uint32_t>(itemCount) << 16, std::memory_order_release);
+
+        // Sequentially consistent, like the worker's count and check in waitForJob: either
+        // the worker sees the new job or this sees the worker parked.
+        jobCounter.fetch_add(1);
+        if (parked.load() > 0)
+        {
+            jobCounter.notify_all();
+        }
+
+        work();
+
+        while (finished.load(std::memory_order_acquire) < itemCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    class Worker : public juce::Thread
+    {
+    public:
+        explicit Worker(RenderThreadPool& pool_) : juce::Thread("JX11 Render"), pool(pool_) { }
+
+        void run() override
+        {
+            uint32_t seen = 0;
+            while (!threadShouldExit())
+            {
+                pool.waitForJob(seen);
+                seen = pool.jobCounter.load(std::memory_order_acquire);
+                pool.work();
+            }
+        }
+
+    private:
+        RenderThreadPool& pool;
+    };
+
+    static constexpr int SPINS = 100;
+
+    void waitForJob(uint32_t seen)
+    {
+        for (int i = 0; i < SPINS; ++i)
+        {
+            if (jobCounter.load(std::memory_order_acquire) != seen) { return; }
+            std::this_thread::yield();
+        }
+
+        parked.fetch_add(1);
+        jobCounter.wait(seen);
+        parked.fetch_sub(1);
+    }
+
+    // A successful claim also means the job it belongs to is still running, so its
+    // function and context stay valid until the item is marked finished.
+    bool claimItem(int& item)
+    {
+        uint32_t word = claim.load(std::memory_order_acquire);
+        while ((word & 0xFFFF) < (word >> 16))
+        {
+            if (claim.compare_exchange_weak(word, word + 1, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                item = static_cast<int>(word & 0xFFFF);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work()
+    {
+        int item;
+        while (claimItem(item))
+        {
+            currentJob(currentContext, item);
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    Job currentJob = nullptr;
+    void* currentContext = nullptr;
+    std::atomic<uint32_t> claim { 0 };       // item count in the high half, next item in the low half
+    std::atomic<int> finished { 0 };
+    std::atomic<uint32_t> jobCounter { 0 };  // workers sleep on this between jobs
+    std::atomic<int> parked { 0 };           // workers asleep on jobCounter, or about to be
+};
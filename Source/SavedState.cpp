@@ -0,0 +1,136 @@
+#include "SavedState.h"
+#include <cstring>
+#include <limits>
+
+// Reads a state, giving zeros and failing for good once it runs past the end.
+struct StateReader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+
+    const uint8_t* skip(size_t bytes)
+    {
+        if (failed || size - position < bytes)
+        {
+            failed = true;
+            return nullptr;
+        }
+        const uint8_t* start = data + position;
+        position += bytes;
+        return start;
+    }
+
+    uint32_t readUInt32()
+    {
+        const uint8_t* bytes = skip(4);
+        return bytes != nullptr ? juce::ByteOrder::littleEndianInt(bytes) : 0;
+    }
+
+    int readInt32() { return static_cast<int>(readUInt32()); }
+};
+
+static float readFloat32(const uint8_t* data)
+{
+    uint32_t bits = juce::ByteOrder::littleEndianInt(data);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+bool SavedState::read(const void* data, size_t size)
+{
+    if (size >= HEADER_SIZE && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0)
+    {
+        return readBinary(static_cast<const uint8_t*>(data), size);
+    }
+
+    if (size > static_cast<size_t>(std::numeric_limits<int>::max())) { return false; }
+    xml = juce::AudioProcessor::getXmlFromBinary(data, static_cast<int>(size));
+    if (xml == nullptr)
+    {
+        xml = juce::parseXML(juce::String::fromUTF8(static_cast<const char*>(data), static_cast<int>(size)));
+    }
+    if (xml == nullptr) { return false; }
+
+    readXmlSettings();
+    return true;
+}
+
+bool SavedState::readBinary(const uint8_t* data, size_t size)
+{
+    StateReader reader { data, size };
+    reader.skip(sizeof(MAGIC));
+    uint32_t version = reader.readUInt32();
+    parameterCount = reader.readUInt32();
+    idTableSize = reader.readUInt32();
+    idTable = reader.skip(idTableSize);
+    values = reader.skip(4 * static_cast<size_t>(parameterCount));
+    if (reader.failed || version == 0 || version > VERSION) { return false; }
+
+    uint32_t programCount = reader.readUInt32();
+    for (uint32_t p = 0; p < programCount && !reader.failed; ++p)
+    {
+        int program = reader.readInt32();
+        if (!reader.failed) { partPrograms.push_back(program); }
+    }
+    morphA = reader.readInt32();
+    morphB = reader.readInt32();
+    uint32_t pathSize = reader.readUInt32();
+    const uint8_t* path = reader.skip(pathSize);
+    if (reader.failed) { return false; }
+
+    bankPath = juce::String::fromUTF8(reinterpret_cast<const char*>(path), static_cast<int>(pathSize));
+    return true;
+}
+
+void SavedState::readXmlSettings()
+{
+    auto tokens = juce::StringArray::fromTokens(xml->getStringAttribute("partPrograms"), false);
+    for (const auto& token : tokens)
+    {
+        partPrograms.push_back(token.getIntValue());
+    }
+
+    auto morph = juce::StringArray::fromTokens(xml->getStringAttribute("morphPrograms"), false);
+    if (morph.size() == 2)
+    {
+        morphA = morph[0].getIntValue();
+        morphB = morph[1].getIntValue();
+    }
+
+    bankPath = xml->getStringAttribute("presetBank");
+}
+
+float SavedState::getValue(int i) const
+{
+    if (i < 0 || i >= getNumValues()) { return 0.0f; }
+    return readFloat32(values + 4 * static_cast<size_t>(i));
+}
+
+std::vector<std::pair<juce::String, float>> SavedState::getParameters() const
+{
+    std::vector<std::pair<juce::String, float>> parameters;
+    if (xml != nullptr)
+    {
+        for (auto* element : xml->getChildWithTagNameIterator("PARAM"))
+        {
+            if (!element->hasAttribute("value")) { continue; }
+            parameters.emplace_back(element->getStringAttribute("id"),
+                                    static_cast<float>(element->getDoubleAttribute("value")));
+        }
+        return parameters;
+    }
+
+    StateReader ids { idTable, idTableSize };
+    for (uint32_t i = 0; i < parameterCount; ++i)
+    {
+        const uint8_t* length = ids.skip(1);
+        const uint8_t* id = ids.skip(length != nullptr ? *length : 0);
+        if (ids.failed) { break; }
+
+        parameters.emplace_back(juce::String::fromUTF8(reinterpret_cast<const char*>(id), *length), getValue(static_cast<int>(i)));
+    }
+    return parameters;
+}
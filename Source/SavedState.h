@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <utility>
+#include <vector>
+
+// A state saved by getStateInformation, read without a processor, so that the bank tool reads
+// states the same way the plugin does. The state is binary, all little endian:
+//
+//     char[8]   "JX11STAT"
+//     uint32    version
+//     uint32    number of parameters
+//     uint32    bytes in the ID table
+//     ID table: per parameter, a uint8 length and the UTF-8 parameter ID
+//     float32   plain value per parameter, in ID table order
+//     uint32    number of part programs, then an int32 for each
+//     int32     morph programs A and B
+//     uint32    bytes in the preset bank path, then the UTF-8 path, empty for the factory set
+//
+// States saved by earlier versions are the XML of the parameter tree, in JUCE's binary
+// wrapper or as text, with the settings as attributes of the root element.
+class SavedState
+{
+public:
+    static constexpr char MAGIC[8] = { 'J', 'X', '1', '1', 'S', 'T', 'A', 'T' };
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 12;
+
+    // Returns false if the data is not a state, or one of a later version. A binary state is
+    // read in place, so the data has to outlive this.
+    bool read(const void* data, size_t size);
+
+    // The XML of a state saved by an earlier version, or null for a binary state.
+    const juce::XmlElement* getXml() const { return xml.get(); }
+
+    // The ID table of a binary state as saved. A state with the same table as the processor's
+    // has its values in the order of the processor's parameters.
+    const uint8_t* getIdTable() const { return idTable; }
+    size_t getIdTableSize() const { return idTableSize; }
+
+    // The plain value of parameter i of a binary state, in ID table order, or 0 for an i
+    // the state has no value for.
+    int getNumValues() const { return static_cast<int>(parameterCount); }
+    float getValue(int i) const;
+
+    // The ID and plain value of every parameter in the state.
+    std::vector<std::pair<juce::String, float>> getParameters() const;
+
+    std::vector<int> partPrograms;
+    int morphA = -1;
+    int morphB = -1;
+    juce::String bankPath;
+
+private:
+    bool readBinary(const uint8_t* data, size_t size);
+    void readXmlSettings();
+
+    std::unique_ptr<juce::XmlElement> xml;
+    const uint8_t* idTable = nullptr;
+    size_t idTableSize = 0;
+    const uint8_t* values = nullptr;
+    uint32_t parameterCount = 0;
+};
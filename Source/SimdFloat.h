@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Builds with JX11_SIMD_LOOP=1 use the plain loops on every platform, so that they can be
+// checked against the other backends.
+#ifndef JX11_SIMD_LOOP
+#define JX11_SIMD_LOOP 0
+#endif
+
+#if JX11_SIMD_LOOP
+#define JX11_USE_AVX 0
+#define JX11_USE_SSE 0
+#elif defined(__AVX__)
+#define JX11_USE_AVX 1
+#define JX11_USE_SSE 0
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JX11_USE_AVX 0
+#define JX11_USE_SSE 1
+#include <emmintrin.h>
+#else
+#define JX11_USE_AVX 0
+#define JX11_USE_SSE 0
+#endif
+
+// Eight float lanes that are processed together. With AVX this is a single register,
+// with SSE2 a pair of registers whose instructions the CPU can overlap, and on other
+// platforms the same operations run as plain loops.
+struct SimdFloat
+{
+    static constexpr int size = 8;
+    static constexpr int alignment = 32;
+
+#if JX11_USE_AVX
+    __m256 v;
+
+    static SimdFloat load(const float* p) { return { _mm256_load_ps(p) }; }
+    static SimdFloat expand(float x) { return { _mm256_set1_ps(x) }; }
+    void store(float* p) const { _mm256_store_ps(p, v); }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm256_add_ps(a.v, b.v) }; }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return { _mm256_div_ps(a.v, b.v) }; }
+    friend SimdFloat operator-(SimdFloat a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+
+    static SimdFloat min(SimdFloat a, SimdFloat b) { return { _mm256_min_ps(a.v, b.v) }; }
+    static SimdFloat max(SimdFloat a, SimdFloat b) { return { _mm256_max_ps(a.v, b.v) }; }
+
+    // Comparisons return a mask with all bits set in the lanes where the test is true.
+    static SimdFloat lessOrEqual(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+    static SimdFloat greaterThan(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+
+    // Picks a where the mask is set, b elsewhere.
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+
+    // One bit per lane, lane 0 in the lowest bit.
+    static int bitmask(SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+
+    // Rounds towards minus infinity, for |x| < 2^31. Goes through integers like the
+    // other backends so -0.0 comes out as 0.0 everywhere.
+    static SimdFloat floor(SimdFloat a)
+    {
+        __m256 t = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a.v));
+        return { _mm256_sub_ps(t, _mm256_and_ps(_mm256_cmp_ps(t, a.v, _CMP_GT_OQ), _mm256_set1_ps(1.0f))) };
+    }
+
+    // 2^n for whole numbers n in [-126, 127], built straight from the exponent bits.
+    static SimdFloat pow2(SimdFloat n)
+    {
+        __m256i i = _mm256_cvttps_epi32(n.v);
+        __m128i bias = _mm_set1_epi32(127);
+        __m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(i), bias), 23);
+        __m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(i, 1), bias), 23);
+        return { _mm256_castsi256_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1)) };
+    }
+#elif JX11_USE_SSE
+    __m128 lo, hi;
+
+    static SimdFloat load(const float* p) { return { _mm_load_ps(p), _mm_load_ps(p + 4) }; }
+    static SimdFloat expand(float x) { return { _mm_set1_ps(x), _mm_set1_ps(x) }; }
+    void store(float* p) const { _mm_store_ps(p, lo); _mm_store_ps(p + 4, hi); }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+    friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+    friend SimdFloat operator-(SimdFloat a)
+    {
+        __m128 sign = _mm_set1_ps(-0.0f);
+        return { _mm_xor_ps(a.lo, sign), _mm_xor_ps(a.hi, sign) };
+    }
+
+    static SimdFloat min(SimdFloat a, SimdFloat b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+    static SimdFloat max(SimdFloat a, SimdFloat b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+
+    static SimdFloat lessOrEqual(SimdFloat a, SimdFloat b) { return { _mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi) }; }
+    static SimdFloat greaterThan(SimdFloat a, SimdFloat b) { return { _mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi) }; }
+
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b)
+    {
+        return { _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)),
+                 _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)) };
+    }
+
+    static int bitmask(SimdFloat mask) { return _mm_movemask_ps(mask.lo) | (_mm_movemask_ps(mask.hi) << 4); }
+
+    static SimdFloat floor(SimdFloat a)
+    {
+        auto floor4 = [](__m128 x)
+        {
+            __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+        };
+        return { floor4(a.lo), floor4(a.hi) };
+    }
+
+    static SimdFloat pow2(SimdFloat n)
+    {
+        __m128i bias = _mm_set1_epi32(127);
+        return { _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n.lo), bias), 23)),
+                 _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n.hi), bias), 23)) };
+    }
+#else
+    float v[size];
+
+    static SimdFloat load(const float* p) { SimdFloat r; for (int i = 0; i < size; ++i) { r.v[i] = p[i]; } return r; }
+    static SimdFloat expand(float x) { SimdFloat r; for (int i = 0; i < size; ++i) { r.v[i] = x; } return r; }
+    void store(float* p) const { for (int i = 0; i < size; ++i) { p[i] = v[i]; } }
+
+    template<typename Op>
+    static SimdFloat apply(SimdFloat a, SimdFloat b, Op op)
+    {
+        SimdFloat r;
+        for (int i = 0; i < size; ++i) { r.v[i] = op(a.v[i], b.v[i]); }
+        return r;
+    }
+
+    static SimdFloat fromMask(SimdFloat a, SimdFloat b, bool (*test)(float, float))
+    {
+        SimdFloat r;
+        for (int i = 0; i < size; ++i)
+        {
+            uint32_t bits = test(a.v[i], b.v[i]) ? 0xFFFFFFFFu : 0u;
+            std::memcpy(&r.v[i], &bits, sizeof(bits));
+        }
+        return r;
+    }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+    friend SimdFloat operator/(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+    friend SimdFloat operator-(SimdFloat a) { return apply(a, a, [](float x, float) { return -x; }); }
+
+    static SimdFloat min(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+    static SimdFloat max(SimdFloat a, SimdFloat b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+    static SimdFloat lessOrEqual(SimdFloat a, SimdFloat b) { return fromMask(a, b, [](float x, float y) { return x <= y; }); }
+    static SimdFloat greaterThan(SimdFloat a, SimdFloat b) { return fromMask(a, b, [](float x, float y) { return x > y; }); }
+
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b)
+    {
+        SimdFloat r;
+        for (int i = 0; i < size; ++i)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &mask.v[i], sizeof(bits));
+            r.v[i] = bits != 0 ? a.v[i] : b.v[i];
+        }
+        return r;
+    }
+
+    static int bitmask(SimdFloat mask)
+    {
+        int bits = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            uint32_t laneBits;
+            std::memcpy(&laneBits, &mask.v[i], sizeof(laneBits));
+            bits |= (laneBits != 0 ? 1 : 0) << i;
+        }
+        return bits;
+    }
+
+    static SimdFloat floor(SimdFloat a)
+    {
+        SimdFloat r;
+        for (int i = 0; i < size; ++i)
+        {
+            float t = static_cast<float>(static_cast<int32_t>(a.v[i]));
+            r.v[i] = t > a.v[i] ? t - 1.0f : t;
+        }
+        return r;
+    }
+
+    static SimdFloat pow2(SimdFloat n)
+    {
+        SimdFloat r;
+        for (int i = 0; i < size; ++i)
+        {
+            uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n.v[i]) + 127) << 23;
+            std::memcpy(&r.v[i], &bits, sizeof(bits));
+        }
+        return r;
+    }
+#endif
+
+    // Mixed with plain floats, which are copied into every lane.
+    friend SimdFloat operator+(SimdFloat a, float b) { return a + expand(b); }
+    friend SimdFloat operator+(float a, SimdFloat b) { return expand(a) + b; }
+    friend SimdFloat operator-(SimdFloat a, float b) { return a - expand(b); }
+    friend SimdFloat operator-(float a, SimdFloat b) { return expand(a) - b; }
+    friend SimdFloat operator*(SimdFloat a, float b) { return a * expand(b); }
+    friend SimdFloat operator*(float a, SimdFloat b) { return expand(a) * b; }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// A value that moves to a new target in equal steps, one per sample. Same interface as
+// juce::LinearSmoothedValue, but every value on the ramp is worked out from where the ramp
+// started instead of by adding up the steps, so a block can be done in one loop without a
+// chain from sample to sample and gives exactly what the same number of getNextValue calls
+// would.
+class LinearRamp
+{
+public:
+    void reset(double sampleRate, double rampLengthInSeconds)
+    {
+        steps = static_cast<int>(std::floor(rampLengthInSeconds * sampleRate));
+        setCurrentAndTargetValue(target);
+    }
+
+    void setCurrentAndTargetValue(float value)
+    {
+        start = target = value;
+        delta = 0.0f;
+        position = steps;
+    }
+
+    void setTargetValue(float value)
+    {
+        if (value == target) { return; }
+        if (steps <= 0)
+        {
+            setCurrentAndTargetValue(value);
+            return;
+        }
+        start = getCurrentValue();
+        target = value;
+        delta = (target - start) / static_cast<float>(steps);
+        position = 0;
+    }
+
+    bool isSmoothing() const { return position < steps; }
+    float getTargetValue() const { return target; }
+    float getCurrentValue() const { return isSmoothing() ? start + delta * static_cast<float>(position) : target; }
+
+    float getNextValue()
+    {
+        if (!isSmoothing()) { return target; }
+        ++position;
+        return getCurrentValue();
+    }
+
+    // output = input times the next sampleCount values. Unchanged values cost one multiply
+    // per sample.
+    void applyGain(float* output, const float* input, int sampleCount)
+    {
+        // The last step lands on the target itself, so it belongs to the second loop.
+        int ramped = isSmoothing() ? std::min(sampleCount, steps - position - 1) : 0;
+        for (int i = 0; i < ramped; ++i)
+        {
+            output[i] = input[i] * (start + delta * static_cast<float>(position + 1 + i));
+        }
+        position = ramped < sampleCount ? steps : position + ramped;
+
+        for (int i = ramped; i < sampleCount; ++i)
+        {
+            output[i] = input[i] * target;
+        }
+    }
+
+    // In place version of applyGain.
+    void applyGain(float* buffer, int sampleCount) { applyGain(buffer, buffer, sampleCount); }
+
+private:
+    float start = 0.0f;
+    float target = 0.0f;
+    float delta = 0.0f;
+    int steps = 0;
+    int position = 0;
+};
+
+// Moves values that are read once per control tick to new targets over a number of ticks.
+// The values themselves stay plain floats wherever they live; only those on their way to a
+// new target are on the active list, so a tick without changes costs one comparison.
+//
+// Linear ramps suit depths and offsets. Ratios such as a detune or a Q take exponential
+// ramps, which move by the same factor every tick.
+class ControlSmoother
+{
+public:
+    static constexpr int MAX_RAMPS = 8;
+
+    // Ramps take this many ticks from now on. Any ramp under way jumps to its target.
+    void reset(int rampSteps)
+    {
+        finish();
+        steps = std::max(rampSteps, 0);
+    }
+
+    void rampLinear(float& value, float target)
+    {
+        ramp(value, target, false);
+    }
+
+    // value and target must have the same sign and not be zero.
+    void rampExponential(float& value, float target)
+    {
+        ramp(value, target, true);
+    }
+
+    bool isSmoothing() const { return activeCount > 0; }
+
+    // One tick further along every active ramp.
+    void advance()
+    {
+        for (int i = 0; i < activeCount; )
+        {
+            Ramp& r = ramps[i];
+            if (--r.remaining <= 0)
+            {
+                *r.value = r.target;
+                r = ramps[--activeCount];
+            }
+            else
+            {
+                *r.value = r.exponential ? *r.value * r.step : *r.value + r.step;
+                ++i;
+            }
+        }
+    }
+
+    // For a smoother copied along with the values it ramps, from an object at from into one
+    // at to: points the ramps at the copies.
+    void rebase(const void* from, void* to)
+    {
+        for (int i = 0; i < activeCount; ++i)
+        {
+            auto offset = reinterpret_cast<const char*>(ramps[i].value) - static_cast<const char*>(from);
+            ramps[i].value = reinterpret_cast<float*>(static_cast<char*>(to) + offset);
+        }
+    }
+
+    // Every value jumps to its target.
+    void finish()
+    {
+        for (int i = 0; i < activeCount; ++i)
+        {
+            *ramps[i].value = ramps[i].target;
+        }
+        activeCount = 0;
+    }
+
+private:
+    struct Ramp
+    {
+        float* value;
+        float target;
+        float step;
+        int remaining;
+        bool exponential;
+    };
+
+    void ramp(float& value, float target, bool exponential)
+    {
+        int i = 0;
+        while (i < activeCount && ramps[i].value != &value) { ++i; }
+
+        if (steps == 0 || (i == activeCount && (value == target || activeCount == MAX_RAMPS)))
+        {
+            if (i < activeCount) { ramps[i] = ramps[--activeCount]; }
+            value = target;
+            return;
+        }
+
+        Ramp& r = ramps[i];
+        if (i == activeCount) { ++activeCount; }
+        r.value = &value;
+        r.target = target;
+        r.remaining = steps;
+        r.exponential = exponential;
+        r.step = exponential ? std::pow(target / value, 1.0f / static_cast<float>(steps))
+                             : (target - value) / static_cast<float>(steps);
+    }
+
+    Ramp ramps[MAX_RAMPS];
+    int activeCount = 0;
+    int steps = 0;
+};
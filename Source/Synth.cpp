@@ -1,5 +1,6 @@
 #include "Synth.h"
 #include "ProtectYourEars.h"
+#include "VoiceBank.h"
 
 static constexpr float ANALOG = 0.002f;
 static constexpr int SUSTAIN = -1;
@@ -10,41 +11,191 @@ static constexpr float ONE_OVER_PI = 0.3183098861837906f;
 Synth::Synth()
 {
     sampleRate = 44100.0f;
+    renderMode = RenderMode::voiceBank;
+    renderThreads = 0;
+    smoothingTime = 0.05f;
+    morphController = 0x0C;
+    multiTimbral = false;
+
+    for (Part& part : parts)
+    {
+        part.oscEngine = OscEngine::blit;
+        part.filterRate = FilterRate::control;
+        part.unison = 1;
+        part.unisonDetune = 0.0f;
+        part.unisonSpread = 0.0f;
+
+        // The first ramps start from here, until the processor sets the real values.
+        part.noiseMix = 0.0f;
+        part.detune = 1.0f;
+        part.filterQ = 1.0f;
+        part.filterEnvDepth = 0.0f;
+        part.vibrato = 0.0f;
+        part.pwmDepth = 0.0f;
+        part.filterKeyTracking = 0.0f;
+        part.filterLFODepth = 0.0f;
+
+        part.morphing = false;
+        part.morphAmount = 0.0f;
+        part.morphMixed = -1.0f;
+    }
 }
 
-void Synth::allocateResources(double sampleRate_, [[maybe_unused]] int samplesPerBlock_)
+void Synth::allocateResources(double sampleRate_, int samplesPerBlock_, int voiceCapacity)
 {
     sampleRate = static_cast<float>(sampleRate_);
 
-    for (int v = 0; v < MAX_VOICES; ++v)
+    voiceCapacity = std::clamp(voiceCapacity, 1, MAX_VOICES);
+    voices.resize(static_cast<size_t>(voiceCapacity));
+    voiceAllocator.allocate(voiceCapacity);
+
+    for (Voice& voice : voices)
     {
-        voices[v].filter.sampleRate = sampleRate;
+        voice.filter.sampleRate = sampleRate;
+    }
+
+    wavetable.build();
+    filterTable.build(sampleRate);
+
+    maxBlockSize = std::max(samplesPerBlock_, 1);
+    maxTicks = maxBlockSize / LFO_MAX + 1;
+
+    voiceBuffers.setSize(2 * voiceCapacity, maxBlockSize);  // the second half for stereo voices
+    noiseBuffer.resize(static_cast<size_t>(maxBlockSize));
+    mixLeft.resize(static_cast<size_t>(maxBlockSize));
+    mixRight.resize(static_cast<size_t>(maxBlockSize));
+    sumLeft.resize(static_cast<size_t>(maxBlockSize));
+    sumRight.resize(static_cast<size_t>(maxBlockSize));
+    levels.resize(static_cast<size_t>(maxBlockSize));
+    panLeft.resize(static_cast<size_t>(voiceCapacity * (maxTicks + 1)));
+    panRight.resize(static_cast<size_t>(voiceCapacity * (maxTicks + 1)));
+    blockVoices.resize(static_cast<size_t>(voiceCapacity));
+    bankGroups.resize(static_cast<size_t>(voiceCapacity));
+
+    for (Part& part : parts)
+    {
+        part.noiseBuffer.resize(static_cast<size_t>(maxBlockSize));
+        part.lfoTicks.resize(static_cast<size_t>(maxTicks));
+    }
+
+    if (renderThreadPool.getNumThreads() != renderThreads)
+    {
+        renderThreadPool.start(renderThreads);
     }
 }
 
 void Synth::deallocateResources()
 {
+    voiceBuffers.setSize(0, 0);
+    noiseBuffer = {};
+    mixLeft = {};
+    mixRight = {};
+    sumLeft = {};
+    sumRight = {};
+    levels = {};
+    panLeft = {};
+    panRight = {};
+    blockVoices = {};
+    bankGroups = {};
+
+    for (Part& part : parts)
+    {
+        part.noiseBuffer = {};
+        part.lfoTicks = {};
+    }
+
+    renderThreadPool.stop();
 }
 
 void Synth::reset()
 {
-    for (int v = 0; v < MAX_VOICES; ++v)
+    for (Voice& voice : voices)
     {
-        voices[v].reset();
+        voice.reset();
     }
+    voiceAllocator.reset();
 
     noiseGenerator.reset();
-    pitchBend = 1.0f;
-    sustainPedalPressed = false;
-    outputLevelSmoother.reset(sampleRate, 0.05);
-    lfo = 0.0f;
-    lfoStep = 0;
-    modWheel = 0.0f;
-    lastNote = 0;
-    resonanceCtl = 1.0f;
-    pressure = 0.0f;
-    filterCtl = 0.0f;
-    filterZip = 0.0f;
+
+    for (Part& part : parts)
+    {
+        resetPart(part);
+    }
+}
+
+void Synth::resetPart(Part& part)
+{
+    part.pitchBend = 1.0f;
+    part.sustainPedalPressed = false;
+    part.outputLevelSmoother.reset(sampleRate, smoothingTime);
+    part.noiseMixSmoother.reset(sampleRate, smoothingTime);
+    part.noiseMixSmoother.setCurrentAndTargetValue(part.noiseMix);
+    part.smoothing.reset(static_cast<int>(smoothingTime * sampleRate / LFO_MAX));
+    part.lfo = 0.0f;
+    part.lfoStep = 0;
+    part.modWheel = 0.0f;
+    part.lastNote = 0;
+    part.resonanceCtl = 1.0f;
+    part.pressure = 0.0f;
+    part.filterCtl = 0.0f;
+    part.filterZip = 0.0f;
+    part.monoVoice = -1;
+    std::fill(std::begin(part.queuedNotes), std::end(part.queuedNotes), 0);
+    part.queuedCount = 0;
+}
+
+void Synth::saveState(State& state) const
+{
+    state.version = State::VERSION;
+    state.sampleRate = sampleRate;
+    state.maxBlockSize = maxBlockSize;
+    state.multiTimbral = multiTimbral;
+    state.voices = voices;
+    state.voiceAllocator = voiceAllocator;
+    state.noiseGenerator = noiseGenerator;
+    state.parts.assign(std::begin(parts), std::end(parts));
+    state.sourceParts = parts;
+    state.sourceWavetable = &wavetable;
+    state.sourceTables = wavetable.data();
+}
+
+bool Synth::restoreState(const State& state)
+{
+    if (state.version != State::VERSION
+        || state.sampleRate != sampleRate
+        || state.maxBlockSize != maxBlockSize
+        || state.voices.size() != voices.size()
+        || state.parts.size() != NUM_PARTS)
+    {
+        return false;
+    }
+
+    multiTimbral = state.multiTimbral;
+
+    voices = state.voices;
+    for (Voice& voice : voices)
+    {
+        voice.rebase(state.sourceWavetable, state.sourceTables, wavetable);
+    }
+    voiceAllocator = state.voiceAllocator;
+    noiseGenerator = state.noiseGenerator;
+
+    // The smoothers ramp values of their own part.
+    for (int p = 0; p < NUM_PARTS; ++p)
+    {
+        parts[p] = state.parts[static_cast<size_t>(p)];
+        parts[p].smoothing.rebase(state.sourceParts + p, &parts[p]);
+    }
+    return true;
+}
+
+void Synth::setMultiTimbral(bool shouldBeMultiTimbral)
+{
+    if (multiTimbral != shouldBeMultiTimbral)
+    {
+        multiTimbral = shouldBeMultiTimbral;
+        releaseVoices();
+    }
 }
 
 void Synth::render(float** outputBuffers, int sampleCount)
@@ -52,40 +203,117 @@ void Synth::render(float** outputBuffers, int sampleCount)
     float* outputBufferLeft = outputBuffers[0];
     float* outputBufferRight = outputBuffers[1];
 
-    for (int v = 0; v < numVoices; ++v)
+    int activeCount = 0;
+    for (int i = 0; i < voiceAllocator.size(); ++i)
     {
-        if (Voice& voice = voices[v]; voice.env.isActive())
+        if (Voice& voice = voices[voiceAllocator[i]]; voice.env.isActive())
         {
+            ++activeCount;
+            const Part& part = parts[voice.part];
             updatePeriod(voice);
-            voice.glideRate = glideRate;
-            voice.filterQ = filterQ * resonanceCtl;
+            voice.glideRate = part.glideRate;
+            voice.filterDamping = 1.0f / (part.filterQ * part.resonanceCtl);
             // skipped pitchBend somewhere?
-            voice.filterEnvDepth = filterEnvDepth;
+            voice.filterEnvDepth = part.filterEnvDepth;
         }
     }
 
-    for (int sample = 0; sample < sampleCount; ++sample)
+    Stats::add(stats.samples, static_cast<uint64_t>(sampleCount));
+    Stats::add(stats.voiceSamples, static_cast<uint64_t>(activeCount) * static_cast<uint64_t>(sampleCount));
+    if (activeCount > stats.peakVoices.load(std::memory_order_relaxed))
     {
-        updateLFO();
+        stats.peakVoices.store(activeCount, std::memory_order_relaxed);
+    }
 
-        float noise = noiseGenerator.nextValue() * noiseMix;
+    if (renderMode == RenderMode::scalar)
+    {
+        renderScalar(outputBufferLeft, outputBufferRight, sampleCount);
+    }
+    else
+    {
+        // Hosts may send more samples than announced in prepareToPlay.
+        for (int offset = 0; offset < sampleCount; offset += maxBlockSize)
+        {
+            int blockSize = std::min(maxBlockSize, sampleCount - offset);
+            renderBlock(outputBufferLeft + offset,
+                        outputBufferRight != nullptr ? outputBufferRight + offset : nullptr,
+                        blockSize);
+        }
+    }
 
-        float outputLeft = 0.0f;
-        float outputRight = 0.0f;
+    // Voices that fell silent go back to the pool once their key is up, so that noteOff
+    // still finds them. Taking them out reorders the heap, so they are collected first.
+    int silent[MAX_VOICES];
+    int silentCount = 0;
+    for (int i = 0; i < voiceAllocator.size(); ++i)
+    {
+        int v = voiceAllocator[i];
+        if (Voice& voice = voices[v]; !voice.env.isActive())
+        {
+            // A voice that ran out in this call still has a level, one that did so before has 0.
+            if (voice.env.level > 0.0f) { Stats::add(stats.voiceEnds); }
+            voice.env.reset();
+            voice.filter.reset();
+            voice.ic1eqRight = voice.ic2eqRight = 0.0f;
+            if (voice.note == 0)
+            {
+                silent[silentCount++] = v;
+            }
+        }
+    }
+    for (int i = 0; i < silentCount; ++i)
+    {
+        voiceAllocator.stop(silent[i]);
+    }
+}
+
+void Synth::renderScalar(float* outputBufferLeft, float* outputBufferRight, int sampleCount)
+{
+    float partLeft[NUM_PARTS];
+    float partRight[NUM_PARTS];
+    float partNoise[NUM_PARTS];
+
+    for (int sample = 0; sample < sampleCount; ++sample)
+    {
+        float noise = noiseGenerator.nextValue();
 
-        for (int v = 0; v < numVoices; ++v)
+        for (int p = 0; p < partCount(); ++p)
         {
-            if (Voice& voice = voices[v]; voice.env.isActive())
+            updateLFO(p);
+            partLeft[p] = 0.0f;
+            partRight[p] = 0.0f;
+            partNoise[p] = noise * parts[p].noiseMixSmoother.getNextValue();
+        }
+
+        for (int i = 0; i < voiceAllocator.size(); ++i)
+        {
+            if (Voice& voice = voices[voiceAllocator[i]]; voice.env.isActive())
             {
-                float output = voice.render(noise);
-                outputLeft += output * voice.panLeft;
-                outputRight += output * voice.panRight;
+                if (voice.isStereo())
+                {
+                    float left, right;
+                    voice.renderStereo(partNoise[voice.part], left, right);
+                    partLeft[voice.part] += left * voice.panLeft;
+                    partRight[voice.part] += right * voice.panRight;
+                }
+                else
+                {
+                    float output = voice.render(partNoise[voice.part]);
+                    partLeft[voice.part] += output * voice.panLeft;
+                    partRight[voice.part] += output * voice.panRight;
+                }
             }
         }
 
-        float outputLevel = outputLevelSmoother.getNextValue();
-        outputLeft *= outputLevel;
-        outputRight *= outputLevel;
+        float outputLeft = 0.0f;
+        float outputRight = 0.0f;
+
+        for (int p = 0; p < partCount(); ++p)
+        {
+            float outputLevel = parts[p].outputLevelSmoother.getNextValue();
+            outputLeft += partLeft[p] * outputLevel;
+            outputRight += partRight[p] * outputLevel;
+        }
 
         if (outputBufferRight != nullptr)
         {
@@ -97,24 +325,267 @@ void Synth::render(float** outputBuffers, int sampleCount)
             outputBufferLeft[sample] = (outputLeft + outputRight) * 0.5f;
         }
     }
+}
 
-    for (int v = 0; v < numVoices; ++v)
+void Synth::renderBlock(float* outputBufferLeft, float* outputBufferRight, int sampleCount)
+{
+    for (int sample = 0; sample < sampleCount; ++sample)
     {
-        if (Voice& voice = voices[v]; !voice.env.isActive())
+        noiseBuffer[static_cast<size_t>(sample)] = noiseGenerator.nextValue();
+    }
+
+    // Voices cannot start in the middle of a sub-block, so this is the full set for it.
+    // The slots of each part are kept together, in the order of the voice allocator.
+    for (int p = 0; p < partCount(); ++p)
+    {
+        parts[p].slotCount = 0;
+    }
+    for (int i = 0; i < voiceAllocator.size(); ++i)
+    {
+        if (const Voice& voice = voices[voiceAllocator[i]]; voice.env.isActive())
         {
-            voice.env.reset();
-            voice.filter.reset();
+            ++parts[voice.part].slotCount;
+        }
+    }
+
+    int slotCount = 0;
+    for (int p = 0; p < partCount(); ++p)
+    {
+        Part& part = parts[p];
+        part.firstSlot = slotCount;
+        slotCount += part.slotCount;
+        part.slotCount = 0;
+
+        part.tickCount = scheduleLFOTicks(part, sampleCount);
+        part.noiseMixSmoother.applyGain(part.noiseBuffer.data(), noiseBuffer.data(), sampleCount);
+    }
+
+    for (int i = 0; i < voiceAllocator.size(); ++i)
+    {
+        if (int v = voiceAllocator[i]; voices[v].env.isActive())
+        {
+            Part& part = parts[voices[v].part];
+            blockVoices[static_cast<size_t>(part.firstSlot + part.slotCount++)] = v;
+        }
+    }
+
+    blockSampleCount = sampleCount;
+    voiceOutputs = voiceBuffers.getArrayOfWritePointers();  // getWritePointer is not for several threads at once
+
+    // Each voice only writes its own slot, so the slots can be rendered on any thread.
+    if (renderMode == RenderMode::voiceBank)
+    {
+        // With helpers, one bank's worth of voices per work item. The lanes of a bank do not
+        // affect each other, so the grouping does not change the output. The voices in a
+        // bank share their LFO ticks, so a bank never mixes parts.
+        int groupSize = renderThreadPool.getNumThreads() > 0 ? VoiceBank::LANES : MAX_VOICES;
+        int groupCount = 0;
+        for (int p = 0; p < partCount(); ++p)
+        {
+            const Part& part = parts[p];
+            for (int first = 0; first < part.slotCount; first += groupSize)
+            {
+                bankGroups[static_cast<size_t>(groupCount++)] =
+                    { p, part.firstSlot + first, std::min(groupSize, part.slotCount - first) };
+            }
+        }
+        renderThreadPool.run(renderVoiceBankJob, this, groupCount);
+    }
+    else
+    {
+        renderThreadPool.run(renderVoiceJob, this, slotCount);
+    }
+
+    // Pan and sum part by part, in voice order so the result matches the scalar path. This
+    // stays on the audio thread, so the order of the additions is the same with or without
+    // helpers.
+    juce::FloatVectorOperations::clear(sumLeft.data(), sampleCount);
+    juce::FloatVectorOperations::clear(sumRight.data(), sampleCount);
+
+    for (int p = 0; p < partCount(); ++p)
+    {
+        Part& part = parts[p];
+        mixPart(part, sampleCount);
+
+        // The same level for both channels, so the ramp goes into a buffer first.
+        juce::FloatVectorOperations::fill(levels.data(), 1.0f, sampleCount);
+        part.outputLevelSmoother.applyGain(levels.data(), sampleCount);
+        juce::FloatVectorOperations::addWithMultiply(sumLeft.data(), mixLeft.data(), levels.data(), sampleCount);
+        juce::FloatVectorOperations::addWithMultiply(sumRight.data(), mixRight.data(), levels.data(), sampleCount);
+    }
+
+    if (outputBufferRight != nullptr)
+    {
+        juce::FloatVectorOperations::copy(outputBufferLeft, sumLeft.data(), sampleCount);
+        juce::FloatVectorOperations::copy(outputBufferRight, sumRight.data(), sampleCount);
+    }
+    else
+    {
+        for (int sample = 0; sample < sampleCount; ++sample)
+        {
+            outputBufferLeft[sample] = (sumLeft[static_cast<size_t>(sample)] + sumRight[static_cast<size_t>(sample)]) * 0.5f;
+        }
+    }
+}
+
+void Synth::mixPart(const Part& part, int sampleCount)
+{
+    juce::FloatVectorOperations::clear(mixLeft.data(), sampleCount);
+    juce::FloatVectorOperations::clear(mixRight.data(), sampleCount);
+
+    for (int i = part.firstSlot; i < part.firstSlot + part.slotCount; ++i)
+    {
+        const float* voiceOutput = voiceBuffers.getReadPointer(i);
+        const float* voiceOutputRight = voices[blockVoices[static_cast<size_t>(i)]].isStereo()
+                                      ? voiceBuffers.getReadPointer(rightChannel(i)) : voiceOutput;
+        const size_t pans = static_cast<size_t>(i * (maxTicks + 1));
+
+        for (int segment = 0; segment <= part.tickCount; ++segment)
+        {
+            int start = segment == 0 ? 0 : part.lfoTicks[static_cast<size_t>(segment - 1)].position;
+            int end = segment == part.tickCount ? sampleCount : part.lfoTicks[static_cast<size_t>(segment)].position;
+            if (end > start)
+            {
+                juce::FloatVectorOperations::addWithMultiply(mixLeft.data() + start, voiceOutput + start,
+                                                             panLeft[pans + static_cast<size_t>(segment)], end - start);
+                juce::FloatVectorOperations::addWithMultiply(mixRight.data() + start, voiceOutputRight + start,
+                                                             panRight[pans + static_cast<size_t>(segment)], end - start);
+            }
+        }
+    }
+}
+
+void Synth::renderVoiceJob(void* context, int slot)
+{
+    Synth& synth = *static_cast<Synth*>(context);
+    synth.renderVoiceBlock(synth.blockVoices[static_cast<size_t>(slot)], slot, synth.blockSampleCount);
+}
+
+void Synth::renderVoiceBankJob(void* context, int group)
+{
+    Synth& synth = *static_cast<Synth*>(context);
+    const BankGroup& bankGroup = synth.bankGroups[static_cast<size_t>(group)];
+    synth.renderVoiceBankBlock(synth.parts[bankGroup.part], bankGroup.firstSlot, bankGroup.slotCount,
+                               synth.blockSampleCount);
+}
+
+void Synth::renderVoiceBlock(int v, int slot, int sampleCount)
+{
+    Voice& voice = voices[v];
+    const Part& part = parts[voice.part];
+    const int tickCount = part.tickCount;
+    float* output = voiceOutputs[slot];
+    float* outputRight = voiceOutputs[rightChannel(slot)];
+    int sample = 0;
+
+    for (int segment = 0; segment <= tickCount; ++segment)
+    {
+        if (!voice.env.isActive())
+        {
+            // The envelope went silent. The pan of the remaining stretches does not matter.
+            for (; segment <= tickCount; ++segment)
+            {
+                recordPanning(slot, voice, segment);
+            }
+            break;
+        }
+
+        if (segment > 0)
+        {
+            applyLFOTick(voice, part.lfoTicks[static_cast<size_t>(segment - 1)]);
+        }
+        recordPanning(slot, voice, segment);
+
+        int end = segment == tickCount ? sampleCount : part.lfoTicks[static_cast<size_t>(segment)].position;
+        if (voice.isStereo())
+        {
+            sample += voice.renderStereoBlock(part.noiseBuffer.data() + sample, output + sample,
+                                              outputRight + sample, end - sample);
+        }
+        else
+        {
+            sample += voice.renderBlock(part.noiseBuffer.data() + sample, output + sample, end - sample);
         }
     }
+
+    // Silence for whatever is left after the voice finished.
+    juce::FloatVectorOperations::clear(output + sample, sampleCount - sample);
+    if (voice.isStereo())
+    {
+        juce::FloatVectorOperations::clear(outputRight + sample, sampleCount - sample);
+    }
+}
+
+void Synth::renderVoiceBankBlock(const Part& part, int firstSlot, int slotCount, int sampleCount)
+{
+    for (int segment = 0; segment <= part.tickCount; ++segment)
+    {
+        int start = segment == 0 ? 0 : part.lfoTicks[static_cast<size_t>(segment - 1)].position;
+        int end = segment == part.tickCount ? sampleCount : part.lfoTicks[static_cast<size_t>(segment)].position;
+        const float* noise = part.noiseBuffer.data() + start;
+
+        Voice* activeVoices[MAX_VOICES];
+        float* outputs[MAX_VOICES];
+        int activeCount = 0;
+
+        for (int i = firstSlot; i < firstSlot + slotCount; ++i)
+        {
+            Voice& voice = voices[blockVoices[static_cast<size_t>(i)]];
+            float* output = voiceOutputs[i] + start;
+            float* outputRight = voiceOutputs[rightChannel(i)] + start;
+
+            if (voice.env.isActive())
+            {
+                if (segment > 0)
+                {
+                    applyLFOTick(voice, part.lfoTicks[static_cast<size_t>(segment - 1)]);
+                }
+
+                if (voice.isStereo())
+                {
+                    // Unison voices already fill the SIMD lanes with their copies.
+                    int rendered = voice.renderStereoBlock(noise, output, outputRight, end - start);
+                    juce::FloatVectorOperations::clear(output + rendered, end - start - rendered);
+                    juce::FloatVectorOperations::clear(outputRight + rendered, end - start - rendered);
+                }
+                else if (voice.osc1.wavetable != nullptr)
+                {
+                    // The bank only knows the BLIT, table voices run on their own.
+                    int rendered = voice.renderBlock(noise, output, end - start);
+                    juce::FloatVectorOperations::clear(output + rendered, end - start - rendered);
+                }
+                else
+                {
+                    activeVoices[activeCount] = &voice;
+                    outputs[activeCount] = output;
+                    ++activeCount;
+                }
+            }
+            else
+            {
+                juce::FloatVectorOperations::clear(output, end - start);
+                if (voice.isStereo())
+                {
+                    juce::FloatVectorOperations::clear(outputRight, end - start);
+                }
+            }
+            recordPanning(i, voice, segment);
+        }
+
+        VoiceBank::render(activeVoices, outputs, activeCount, noise, end - start);
+    }
 }
 
 void Synth::midiMessage(uint8_t data0, uint8_t data1, uint8_t data2)
 {
+    const int p = multiTimbral ? (data0 & 0x0F) : 0;
+    Part& part = parts[p];
+
     switch (data0 & 0xF0)
     {
     case 0x80:
         {
-            noteOff(data1 & 0x7F);
+            noteOff(p, data1 & 0x7F);
             break;
         }
     case 0x90:
@@ -123,161 +594,292 @@ void Synth::midiMessage(uint8_t data0, uint8_t data1, uint8_t data2)
             uint8_t velocity = data2 & 0x7F;
             if (velocity > 0)
             {
-                noteOn(note, velocity);
+                noteOn(p, note, velocity);
             }
             else
             {
-                noteOff(note);
+                noteOff(p, note);
             }
             break;
         }
     case 0xE0:
         {
-            pitchBend = std::exp(-0.000014102f * static_cast<float>(data1 + 128 * data2 - 8192));
+            part.pitchBend = FastMath::exp(-0.000014102f * static_cast<float>(data1 + 128 * data2 - 8192));
             break;
         }
     case 0xB0:
         {
-            controlChange(data1, data2);
+            controlChange(p, data1, data2);
             break;
         }
     case 0xD0:
         {
-            pressure = 0.0001f * static_cast<float>(data1 * data1);
+            part.pressure = 0.0001f * static_cast<float>(data1 * data1);
             break;
         }
     }
 }
 
-void Synth::controlChange(uint8_t data1, uint8_t data2)
+void Synth::controlChange(int p, uint8_t data1, uint8_t data2)
 {
+    Part& part = parts[p];
+
+    if (data1 == morphController)
+    {
+        part.morphAmount = static_cast<float>(data2) / 127.0f;
+        return;
+    }
+
     switch (data1)
     {
     // sustain pedal
     case 0x40:
         {
-            sustainPedalPressed = (data2 >= 64);
+            part.sustainPedalPressed = (data2 >= 64);
 
-            if (!sustainPedalPressed)
+            if (!part.sustainPedalPressed)
             {
-                noteOff(SUSTAIN);
+                noteOff(p, SUSTAIN);
             }
             break;
         }
         // Mod wheel
     case 0x01:
         {
-            modWheel = 0.000005f * static_cast<float>(data2 * data2);
+            part.modWheel = 0.000005f * static_cast<float>(data2 * data2);
             break;
         }
     case 0x47:
         {
-            resonanceCtl = 154.0f / static_cast<float>(154 - data2);
+            part.resonanceCtl = 154.0f / static_cast<float>(154 - data2);
             break;
         }
         // Filter +
     case 0x4A:
         {
-            filterCtl = 0.02f * static_cast<float>(data2);
+            part.filterCtl = 0.02f * static_cast<float>(data2);
             break;
         }
         // Filter -
     case 0x4B:
         {
-            filterCtl = -0.03f * static_cast<float>(data2);
+            part.filterCtl = -0.03f * static_cast<float>(data2);
             break;
         }
     default:
         {
             if (data1 >= 0x78)
             {
-                for (int v =0; v < MAX_VOICES; ++v)
-                {
-                    voices[v].reset();
-                }
+                releaseVoices(p);
             }
-            sustainPedalPressed = false;
+            part.sustainPedalPressed = false;
         }
     }
 }
 
+void Synth::capturePatch(const Part& part, PatchValues& values)
+{
+    values.oscMix = part.oscMix;
+    values.noiseMix = part.noiseMix;
+    values.detune = part.detune;
+    values.tune = part.tune;
+    values.volumeTrim = part.volumeTrim;
+    values.outputLevel = part.outputLevelSmoother.getTargetValue();
+    values.velocitySensitivity = part.velocitySensitivity;
+    values.envAttack = part.envAttack;
+    values.envDecay = part.envDecay;
+    values.envSustain = part.envSustain;
+    values.envRelease = part.envRelease;
+    values.lfoInc = part.lfoInc;
+    values.vibrato = part.vibrato;
+    values.pwmDepth = part.pwmDepth;
+    values.glideRate = part.glideRate;
+    values.glideBend = part.glideBend;
+    values.filterKeyTracking = part.filterKeyTracking;
+    values.filterQ = part.filterQ;
+    values.filterLFODepth = part.filterLFODepth;
+    values.filterAttack = part.filterAttack;
+    values.filterDecay = part.filterDecay;
+    values.filterSustain = part.filterSustain;
+    values.filterRelease = part.filterRelease;
+    values.filterEnvDepth = part.filterEnvDepth;
+    values.ignoreVelocity = part.ignoreVelocity;
+    values.glideMode = part.glideMode;
+}
+
+// The noise and the output level are smoothed per sample, the rest change at the tick.
+void Synth::playPatch(Part& part, const PatchValues& values)
+{
+    part.oscMix = values.oscMix;
+    part.noiseMix = values.noiseMix;
+    part.noiseMixSmoother.setTargetValue(values.noiseMix);
+    part.detune = values.detune;
+    part.tune = values.tune;
+    part.volumeTrim = values.volumeTrim;
+    part.outputLevelSmoother.setTargetValue(values.outputLevel);
+    part.velocitySensitivity = values.velocitySensitivity;
+    part.envAttack = values.envAttack;
+    part.envDecay = values.envDecay;
+    part.envSustain = values.envSustain;
+    part.envRelease = values.envRelease;
+    part.lfoInc = values.lfoInc;
+    part.vibrato = values.vibrato;
+    part.pwmDepth = values.pwmDepth;
+    part.glideRate = values.glideRate;
+    part.glideBend = values.glideBend;
+    part.filterKeyTracking = values.filterKeyTracking;
+    part.filterQ = values.filterQ;
+    part.filterLFODepth = values.filterLFODepth;
+    part.filterAttack = values.filterAttack;
+    part.filterDecay = values.filterDecay;
+    part.filterSustain = values.filterSustain;
+    part.filterRelease = values.filterRelease;
+    part.filterEnvDepth = values.filterEnvDepth;
+    part.ignoreVelocity = values.ignoreVelocity;
+    part.glideMode = values.glideMode;
+}
+
 void Synth::releaseVoices()
 {
-    for (int v = 0; v < numVoices; ++v)
+    for (Voice& voice : voices)
     {
-        voices[v].reset();
-        voices[v].note = 0;
+        voice.reset();
+        voice.note = 0;
+    }
+    voiceAllocator.reset();
+
+    for (Part& part : parts)
+    {
+        part.monoVoice = -1;
+        std::fill(std::begin(part.queuedNotes), std::end(part.queuedNotes), 0);
+        part.queuedCount = 0;
     }
 }
 
-float Synth::calcPeriod(int v, int note) const
+void Synth::releaseVoices(int p)
 {
-    float period = tune * std::exp(-0.05776226505f * (static_cast<float>(note) + ANALOG * static_cast<float>(v)));
-    while (period < 6.0f || (period * detune) < 6.0f) { period += period; } // BLIT osc may now work properly with such small period
+    if (!multiTimbral)
+    {
+        releaseVoices();
+        return;
+    }
+
+    // Stopping a voice reorders the heap, so the part's voices are collected first.
+    int matching[MAX_VOICES];
+    int matchingCount = 0;
+    for (int i = 0; i < voiceAllocator.size(); ++i)
+    {
+        if (int v = voiceAllocator[i]; voices[v].part == p)
+        {
+            matching[matchingCount++] = v;
+        }
+    }
+
+    for (int i = 0; i < matchingCount; ++i)
+    {
+        voices[matching[i]].reset();
+        voiceAllocator.stop(matching[i]);
+    }
+
+    Part& part = parts[p];
+    part.monoVoice = -1;
+    std::fill(std::begin(part.queuedNotes), std::end(part.queuedNotes), 0);
+    part.queuedCount = 0;
+}
+
+float Synth::calcPeriod(const Part& part, int v, int note) const
+{
+    // The analog drift repeats every eight voices, so high voice numbers do not go out of tune.
+    float period = part.tune * FastMath::exp(-0.05776226505f * (static_cast<float>(note) + ANALOG * static_cast<float>(v % 8)));
+    const float shortest = minPeriod(part);
+    while (period < shortest || (period * part.detune) < shortest) { period += period; } // the oscillators cannot go higher than this
     return period;
 }
 
-void Synth::startVoice(int v, int note, int velocity)
+void Synth::startVoice(int p, int v, int note, int velocity)
 {
+    Part& part = parts[p];
+
     // earlier simple formula was used
     // float freq = 440.0f * std::exp2((float(note - 69) + tune) / 12.0f);
-    float period = calcPeriod(v, note);
+    float period = calcPeriod(part, v, note);
+
+    voiceAllocator.start(v);
 
     Voice& voice = voices[v];
+    voice.part = p;
     voice.target = period;
 
     int noteDistance = 0;
-    if (lastNote > 0)
+    if (part.lastNote > 0)
     {
-        if ((glideMode == 2) || ((glideMode == 1) && isPlyingLegatoStyle()))
+        if ((part.glideMode == 2) || ((part.glideMode == 1) && isPlyingLegatoStyle(p)))
         {
-            noteDistance = note - lastNote;
+            noteDistance = note - part.lastNote;
         }
     }
 
-    voice.period = period * std::pow(1.059463094359f, static_cast<float>(noteDistance) - glideBend);
+    voice.period = period * FastMath::exp(0.05776226505f * (static_cast<float>(noteDistance) - part.glideBend));  // 1.059463094359^semitones
 
-    if (voice.period < 6.0f) { voice.period = 6.0f; }
+    if (voice.period < minPeriod(part)) { voice.period = minPeriod(part); }
 
     voice.targetPanning = std::clamp((note - 60.0f) / 24.0f, -1.0f, 1.0f);
 
-    lastNote = note;
+    part.lastNote = note;
     voice.note = note;
     //voice.updatePanning();
 
     float vel = 0.004f * static_cast<float>((velocity + 64) * (velocity + 64)) - 8.0f;
-    voice.osc1.amplitude = volumeTrim * vel;
-    voice.osc2.amplitude = voice.osc1.amplitude * oscMix;
+    voice.osc1.amplitude = part.volumeTrim * vel;
+    voice.osc2.amplitude = voice.osc1.amplitude * part.oscMix;
+
+    const Wavetable* table = part.oscEngine == OscEngine::wavetable ? &wavetable : nullptr;
+    if (voice.osc1.wavetable != table)
+    {
+        // The state of one engine means nothing to the other.
+        voice.osc1.reset();
+        voice.osc2.reset();
+        voice.osc1.wavetable = table;
+        voice.osc2.wavetable = table;
+    }
 
-    if (vibrato == 0.0f && pwmDepth > 0.0f) {
+    voice.unison.setup(part.unison, part.unisonDetune, part.unisonSpread, ANALOG);
+
+    if (part.vibrato == 0.0f && part.pwmDepth > 0.0f) {
+        updatePeriod(voice);  // the wavetable offset is measured in periods of osc2
         voice.osc2.squareWave(voice.osc1, voice.period);
+        if (voice.isStereo())
+        {
+            voice.unison.squareWave(voice.period);
+        }
     }
 
     Envelope& env = voice.env;
-    env.attackMultiplier = envAttack;
-    env.decayMultiplier = envDecay;
-    env.sustainLevel = envSustain;
-    env.releaseMultiplier = envRelease;
+    env.attackMultiplier = part.envAttack;
+    env.decayMultiplier = part.envDecay;
+    env.sustainLevel = part.envSustain;
+    env.releaseMultiplier = part.envRelease;
     env.attack();
 
-    voice.cutoff = sampleRate / (period * PI);
-    voice.cutoff *= std::exp(velocitySensitivity * static_cast<float>(velocity - 64));
+    voice.logCutoff = std::log(sampleRate / (period * PI));
+    voice.logCutoff += part.velocitySensitivity * static_cast<float>(velocity - 64);
 
     Envelope& filterEnv = voice.filterEnv;
-    filterEnv.attackMultiplier = filterAttack;
-    filterEnv.decayMultiplier = filterDecay;
-    filterEnv.sustainLevel = filterSustain;
-    filterEnv.releaseMultiplier = filterRelease;
+    filterEnv.attackMultiplier = part.filterAttack;
+    filterEnv.decayMultiplier = part.filterDecay;
+    filterEnv.sustainLevel = part.filterSustain;
+    filterEnv.releaseMultiplier = part.filterRelease;
     filterEnv.attack();
 }
 
-void Synth::restartMonoVoice(int note, int velocity)
+void Synth::restartMonoVoice(int p, int note, int velocity)
 {
-    float period = calcPeriod(0, note);
-    Voice& voice = voices[0];
+    Part& part = parts[p];
+    float period = calcPeriod(part, part.monoVoice, note);
+    Voice& voice = voices[part.monoVoice];
     voice.target = period;
 
-    if (glideMode == 0) { voice.period = period; }
+    if (part.glideMode == 0) { voice.period = period; }
 
     voice.targetPanning = std::clamp((note - 60.0f) / 24.0f, -1.0f, 1.0f);
 
@@ -286,204 +888,331 @@ void Synth::restartMonoVoice(int note, int velocity)
     //voice.updatePanning();
 }
 
-void Synth::noteOn(int note, int velocity)
+void Synth::noteOn(int p, int note, int velocity)
 {
+    Part& part = parts[p];
 
-    if (ignoreVelocity) { velocity = 80; }
+    if (part.ignoreVelocity) { velocity = 80; }
 
-    int v = 0; // mono
+    int v = 0;
 
-    if (numVoices == 1) // poly
+    if (part.numVoices == 1) // mono
     {
-       if (voices[0].note > 0) // legato-style plying
+       // Another part may have taken the voice over in the meantime.
+       int mono = part.monoVoice;
+       if (mono >= 0 && voices[mono].part == p && voices[mono].note > 0) // legato-style plying
        {
-           shiftQueuedNotes();
-           restartMonoVoice(note, velocity);
+           shiftQueuedNotes(part);
+           restartMonoVoice(p, note, velocity);
            return;
        }
+
+       // On its own, the part always plays its mono notes on the first voice.
+       v = multiTimbral ? findFreeVoice(p) : 0;
+       part.monoVoice = v;
     }
     else
     {
-        v = findFreeVoice();
+        v = findFreeVoice(p);
     }
 
-    startVoice(v, note, velocity);
+    startVoice(p, v, note, velocity);
 }
 
-void Synth::noteOff(int note)
+void Synth::noteOff(int p, int note)
 {
-    if ((numVoices == 1)) {
-        if (voices[0].note == note)
+    Part& part = parts[p];
+
+    if ((part.numVoices == 1)) {
+        int mono = part.monoVoice;
+        if (mono >= 0 && voices[mono].part == p && voices[mono].note == note)
         {
-            int queuedNote = nextQueuedNote();
+            int queuedNote = nextQueuedNote(part);
             if (queuedNote > 0) {
-                restartMonoVoice(queuedNote, -1);
+                restartMonoVoice(p, queuedNote, -1);
             }
         }
         else // in case key further in queue was released
         {
-            for (int v = 0; v < MAX_VOICES; ++v)
+            for (int i = 0; i < part.queuedCount; ++i)
             {
-                if (voices[v].note == note)
+                if (part.queuedNotes[i] == note)
                 {
-                    voices[v].note = 0;
+                    part.queuedNotes[i] = 0;
+                    trimQueuedNotes(part);
                     break;
                 }
             }
         }
     }
 
-    for (int v = 0; v < numVoices; ++v)
+    // Releasing a voice reorders the heap, so the voices are collected first.
+    int matching[MAX_VOICES];
+    int matchingCount = 0;
+    for (int i = 0; i < voiceAllocator.size(); ++i)
     {
-        if (voices[v].note == note)
+        if (int v = voiceAllocator[i]; voices[v].part == p && voices[v].note == note)
         {
-            if (sustainPedalPressed)
-            {
-                voices[v].note = SUSTAIN;
-            }
-            else
-            {
-                voices[v].release();
-                voices[v].note = 0;
-            }
+            matching[matchingCount++] = v;
+        }
+    }
+
+    for (int i = 0; i < matchingCount; ++i)
+    {
+        int v = matching[i];
+        if (part.sustainPedalPressed)
+        {
+            voices[v].note = SUSTAIN;
+        }
+        else
+        {
+            voices[v].release();
+            voices[v].note = 0;
+            voiceAllocator.release(v);
         }
     }
 }
 
-int Synth::findFreeVoice() const
+int Synth::findFreeVoice(int p)
 {
-    int v = 0;
-    float l = 100.0f; // louder than anything
+    const Part& part = parts[p];
+    const int voiceCount = static_cast<int>(voices.size());
 
-    for (int i = 0; i < numVoices; ++i)
+    if (!multiTimbral)
     {
-        if (voices[i].env.level < l && !voices[i].env.isActive())
+        // The polyphony may have changed since the last note.
+        if (voiceAllocator.getLimit() != std::min(part.numVoices, voiceCount))
         {
-            l = voices[i].env.level;
-            v = i;
+            voiceAllocator.setLimit(part.numVoices);
         }
+
+        int v = voiceAllocator.nextFree();
+        if (v >= 0) { return v; }
+        return countSteal(voiceAllocator.victim());
     }
 
+    // The parts share the whole pool, but each keeps to its own polyphony by taking over
+    // one of its own voices when it is at its limit.
+    if (voiceAllocator.getLimit() != voiceCount)
+    {
+        voiceAllocator.setLimit(voiceCount);
+    }
+
+    int sounding = 0;
+    for (int i = 0; i < voiceAllocator.size(); ++i)
+    {
+        if (voices[voiceAllocator[i]].part == p) { ++sounding; }
+    }
+
+    if (sounding >= part.numVoices)
+    {
+        return countSteal(voiceAllocator.victim([this, p](int v) { return voices[v].part == p; }));
+    }
+
+    int v = voiceAllocator.nextFree();
+    if (v >= 0) { return v; }
+    return countSteal(voiceAllocator.victim());
+}
+
+// A victim whose envelope has already run out was not heard, so taking it is no steal.
+int Synth::countSteal(int v)
+{
+    if (voices[v].env.isActive()) { Stats::add(stats.voiceSteals); }
     return v;
 }
 
-void Synth::shiftQueuedNotes()
+// The queue holds the keys that are still down behind the one the mono voice plays, most
+// recent first. It is as long as the pool minus the playing voice. Released keys leave
+// zeros behind, and queuedCount ends after the last key that is not one.
+void Synth::shiftQueuedNotes(Part& part)
 {
-    for (int tmp = MAX_VOICES - 1; tmp > 0; tmp--)
+    part.queuedCount = std::min(part.queuedCount + 1, static_cast<int>(voices.size()) - 1);
+    for (int tmp = part.queuedCount - 1; tmp > 0; tmp--)
     {
-        voices[tmp].note = voices[tmp - 1].note;
-        voices[tmp].release();
+        part.queuedNotes[tmp] = part.queuedNotes[tmp - 1];
     }
+    part.queuedNotes[0] = voices[part.monoVoice].note;
+    trimQueuedNotes(part);  // a full queue drops its last key, which may leave a zero at the end
+    Stats::add(stats.monoShifts);
 }
 
-int Synth::nextQueuedNote()
+int Synth::nextQueuedNote(Part& part)
 {
-    int held = 0;
-    for (int v = MAX_VOICES - 1; v > 0; v--)
+    for (int i = 0; i < part.queuedCount; ++i)
     {
-        if (voices[v].note > 0) { held = v; }
+        if (part.queuedNotes[i] > 0)
+        {
+            int note = part.queuedNotes[i];
+            part.queuedNotes[i] = 0;
+            trimQueuedNotes(part);
+            return note;
+        }
     }
 
-    if (held > 0)
+    return 0;
+}
+
+void Synth::trimQueuedNotes(Part& part)
+{
+    while (part.queuedCount > 0 && part.queuedNotes[part.queuedCount - 1] == 0)
     {
-        int note = voices[held].note;
-        voices[held].note = 0;
-        return note;
+        --part.queuedCount;
     }
+}
 
-    return 0;
+void Synth::updateLFO(int p)
+{
+    Part& part = parts[p];
+
+    if (--part.lfoStep <= 0)
+    {
+        part.lfoStep = LFO_MAX;
+
+        LFOTick tick = nextLFOTick(part);
+
+        for (int i = 0; i < voiceAllocator.size(); ++i)
+        {
+            Voice& voice = voices[voiceAllocator[i]];
+            if (voice.part == p && voice.env.isActive())
+            {
+                applyLFOTick(voice, tick);
+            }
+        }
+    }
 }
 
-void Synth::updateLFO()
+Synth::LFOTick Synth::nextLFOTick(Part& part)
 {
-    if (--lfoStep <= 0)
+    part.smoothing.advance();
+
+    if (part.morphing && part.morphAmount != part.morphMixed)
     {
-        lfoStep = LFO_MAX;
+        PatchValues values;
+        PatchValues::mix(values, part.morphA, part.morphB, part.morphAmount);
+        part.smoothing.finish();
+        playPatch(part, values);
+        part.morphMixed = part.morphAmount;
+    }
+
+    float& lfo = part.lfo;
+    const float modWheel = part.modWheel;
+    const float vibrato = part.vibrato;
+    const float pwmDepth = part.pwmDepth;
+    const int lfoWave = part.lfoWave;
 
-        lfo += lfoInc;
-        if (lfo > PI) { lfo -= TWO_PI; }
+    lfo += part.lfoInc;
+    if (lfo > PI) { lfo -= TWO_PI; }
 
-        float vibratoMod = 0.0f, pwm = 0.0f, wave = 0.0f;
+    float vibratoMod = 0.0f, pwm = 0.0f, wave = 0.0f;
 
-        if (lfoWave == 0 || vibrato <= 0)
+    if (lfoWave == 0 || vibrato <= 0)
+    {
+        const float sine = FastMath::sin(lfo);
+        wave = sine;
+        vibratoMod = 1.0f + sine * (modWheel + vibrato);
+        pwm = 1.0f + sine * (modWheel + pwmDepth);
+    }
+    else if (lfoWave == 1)
+    {
+        float triangle = 0.0f;
+        if (std::abs(lfo) < PI_OVER_TWO)
         {
-            const float sine = std::sin(lfo);
-            wave = sine;
-            vibratoMod = 1.0f + sine * (modWheel + vibrato);
-            pwm = 1.0f + sine * (modWheel + pwmDepth);
+            triangle = lfo * TWO_OVER_PI;
         }
-        else if (lfoWave == 1)
+        else
         {
-            float triangle = 0.0f;
-            if (std::abs(lfo) < PI_OVER_TWO)
+            if (lfo > 0.0f)
             {
-                triangle = lfo * TWO_OVER_PI;
+                triangle = -lfo * TWO_OVER_PI + 2.0f;
             }
             else
             {
-                if (lfo > 0.0f)
-                {
-                    triangle = -lfo * TWO_OVER_PI + 2.0f;
-                }
-                else
-                {
-                    triangle = -lfo * TWO_OVER_PI - 2.0f;
-                }
+                triangle = -lfo * TWO_OVER_PI - 2.0f;
             }
-
-            wave = triangle;
-            vibratoMod = 1.0f + triangle * (modWheel + vibrato);
-            pwm = 1.0f + triangle * (modWheel + pwmDepth);
         }
-        else if (lfoWave == 2)
-        {
-            float saw = lfo * ONE_OVER_PI;
 
-            wave = saw;
-            vibratoMod = 1.0f + saw * (modWheel + vibrato);
-            pwm = 1.0f + saw * (modWheel + pwmDepth);
+        wave = triangle;
+        vibratoMod = 1.0f + triangle * (modWheel + vibrato);
+        pwm = 1.0f + triangle * (modWheel + pwmDepth);
+    }
+    else if (lfoWave == 2)
+    {
+        float saw = lfo * ONE_OVER_PI;
+
+        wave = saw;
+        vibratoMod = 1.0f + saw * (modWheel + vibrato);
+        pwm = 1.0f + saw * (modWheel + pwmDepth);
+    }
+    else if (lfoWave == 3)
+    {
+        if (lfo >= 0.0f)
+        {
+            wave = 1.0f;
+            vibratoMod = 1.0f + (modWheel + vibrato);
+            pwm = 1.0f + (modWheel + pwmDepth);
         }
-        else if (lfoWave == 3)
+        else
         {
-            if (lfo >= 0.0f)
-            {
-                wave = 1.0f;
-                vibratoMod = 1.0f + (modWheel + vibrato);
-                pwm = 1.0f + (modWheel + pwmDepth);
-            }
-            else
-            {
-                wave = -1.0f;
-                vibratoMod = 1.0f - (modWheel + vibrato);
-                pwm = 1.0f - (modWheel + pwmDepth);
-            }
+            wave = -1.0f;
+            vibratoMod = 1.0f - (modWheel + vibrato);
+            pwm = 1.0f - (modWheel + pwmDepth);
         }
+    }
+
+    float filterMod = part.filterKeyTracking + part.filterCtl + (part.filterLFODepth + part.pressure) * wave;
+    part.filterZip += 0.005f * (filterMod - part.filterZip);
+
+    float filterDamping = 1.0f / (part.filterQ * part.resonanceCtl);
+    return { 0, vibratoMod, pwm, part.filterZip, part.detune, filterDamping, part.filterEnvDepth };
+}
 
-        float filterMod = filterKeyTracking + filterCtl + (filterLFODepth + pressure) * wave;
-        filterZip += 0.005f * (filterMod - filterZip);
+void Synth::applyLFOTick(Voice& voice, const LFOTick& tick) const
+{
+    voice.osc1.modulation = tick.vibratoMod;
+    voice.osc2.modulation = tick.pwm;
+    voice.filterMod = tick.filterMod;
+    voice.filterDamping = tick.filterDamping;
+    voice.filterEnvDepth = tick.filterEnvDepth;
+    // In audio rate mode the coefficients reach the values of this tick when the next one fires.
+    voice.updateLFO(filterTable, parts[voice.part].filterRate == FilterRate::audio ? 1.0f / LFO_MAX : 0.0f);
+    updatePeriod(voice, tick.detune);
+}
 
-        for (int v = 0; v < numVoices; ++v)
+int Synth::scheduleLFOTicks(Part& part, int sampleCount)
+{
+    // Same countdown as updateLFO, but jumping straight to the samples where the LFO fires.
+    int tickCount = 0;
+    int sample = 0;
+    while (sample < sampleCount)
+    {
+        if (--part.lfoStep <= 0)
         {
-            Voice& voice = voices[v];
-            if (voice.env.isActive())
-            {
-                voice.osc1.modulation = vibratoMod;
-                voice.osc2.modulation = pwm;
-                voice.filterMod = filterZip;
-                voice.updateLFO();
-                updatePeriod(voice);
-            }
+            part.lfoStep = LFO_MAX;
+            part.lfoTicks[static_cast<size_t>(tickCount)] = nextLFOTick(part);
+            part.lfoTicks[static_cast<size_t>(tickCount)].position = sample;
+            ++tickCount;
         }
+
+        int length = std::min(part.lfoStep, sampleCount - sample);
+        part.lfoStep -= length - 1;
+        sample += length;
     }
+    return tickCount;
 }
 
-bool Synth::isPlyingLegatoStyle() const
+bool Synth::isPlyingLegatoStyle(int p) const
 {
-    int held = 0;
-    for (int i = 0; i < MAX_VOICES; ++i)
+    const Part& part = parts[p];
+
+    if (part.queuedCount > 0) { return true; }
+
+    // A voice that holds a note is always among the sounding ones, so only those are looked
+    // at. The first voice has never counted here.
+    for (int i = 0; i < voiceAllocator.size(); ++i)
     {
-        if (voices[i].note > 0) { held += i; }
+        int v = voiceAllocator[i];
+        if (v != 0 && voices[v].part == p && voices[v].note > 0) { return true; }
     }
 
-    return held > 0;
+    return false;
 }
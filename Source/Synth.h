@@ -2,86 +2,323 @@
 
 #include <JuceHeader.h>
 #include "Voice.h"
+#include "VoiceAllocator.h"
 #include "NoiseGenerator.h"
+#include "RenderThreadPool.h"
+#include "Smoothing.h"
+#include "Morph.h"
 
 class Synth
 {
 public:
     Synth();
 
-    void allocateResources(double sampleRate, int samplesPerBlock);
+    void allocateResources(double sampleRate, int samplesPerBlock, int voiceCapacity);
     void deallocateResources();
     void reset();
     void render(float** outputBuffers, int sampleCount);
     void midiMessage(uint8_t data0, uint8_t data1, uint8_t data2);
-    void controlChange(uint8_t data1, uint8_t data2);
     void releaseVoices();
+    void releaseVoices(int part);
 
-    float noiseMix;
-    float oscMix;
-    float detune;
-    float tune;
-    float volumeTrim;
-    juce::LinearSmoothedValue<float> outputLevelSmoother;
-
-    float velocitySensitivity;
-    bool ignoreVelocity;
-
-    float envAttack;
-    float envDecay;
-    float envSustain;
-    float envRelease;
-
-    const int LFO_MAX = 32;
-    float lfoInc;
-    float vibrato;
-    float pwmDepth;
-    int lfoWave;
-
-    int glideMode;
-    float glideRate;
-    float glideBend;
-
-    static constexpr int MAX_VOICES = 8;
-    int numVoices;
-    int prevNumVoices;
-    float filterKeyTracking;
-    float filterQ;
-    float resonanceCtl;
-    float filterLFODepth;
-    float pressure;
-    float filterCtl;
-    float filterAttack, filterDecay, filterSustain, filterRelease;
-    float filterEnvDepth;
+    enum class RenderMode
+    {
+        scalar,     // all voices interleaved sample by sample, the reference path
+        block,      // one voice at a time for the whole sub-block
+        voiceBank   // several voices per SIMD instruction
+    };
+    RenderMode renderMode;
+
+    enum class OscEngine
+    {
+        blit,       // band-limited impulse train made from a sine recurrence
+        wavetable   // interpolated reads from precomputed band-limited tables
+    };
+
+    enum class FilterRate
+    {
+        control,    // coefficients change once per LFO tick
+        audio       // coefficients glide from one LFO tick to the next, sample by sample
+    };
+
+    // Worker threads that render voices next to the audio thread in the block modes, or 0 to
+    // render everything on the calling thread. Takes effect in allocateResources. The output
+    // does not depend on it.
+    int renderThreads;
+
+    // Seconds over which parameter changes glide to their new values, so that they do not
+    // step at block boundaries. Takes effect in reset. 0 turns smoothing off.
+    float smoothingTime;
+
+    // The controller that sets the morph amount of its channel's part, or -1 for none.
+    int morphController;
+
+    // What the engine did, for capacity planning. Only the audio thread counts, with plain
+    // loads and stores, so any other thread can read the counters while it plays.
+    struct Stats
+    {
+        std::atomic<uint64_t> samples { 0 };
+        std::atomic<uint64_t> voiceSamples { 0 };  // active voices, summed over the samples
+        std::atomic<int> peakVoices { 0 };
+        std::atomic<uint64_t> voiceSteals { 0 };   // notes that took over a voice still in use
+        std::atomic<uint64_t> monoShifts { 0 };    // held keys pushed onto a mono part's queue
+        std::atomic<uint64_t> voiceEnds { 0 };     // voices whose envelope ran out
+
+        static void add(std::atomic<uint64_t>& counter, uint64_t amount = 1)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        // On the audio thread.
+        void reset()
+        {
+            for (auto* counter : { &samples, &voiceSamples, &voiceSteals, &monoShifts, &voiceEnds })
+            {
+                counter->store(0, std::memory_order_relaxed);
+            }
+            peakVoices.store(0, std::memory_order_relaxed);
+        }
+    };
+    Stats stats;
+
+    static constexpr int LFO_MAX = 32;
+    static constexpr int MAX_VOICES = 128;  // most voices allocateResources will set up
+    static constexpr int NUM_PARTS = 16;    // one for each MIDI channel
+
+    // Values computed by the LFO for one control tick, at the sample where they take effect.
+    // The smoothed part values that voices read come along, as the block renderers only get
+    // to the ticks after all of them were computed.
+    struct LFOTick
+    {
+        int position;
+        float vibratoMod;
+        float pwm;
+        float filterMod;
+        float detune;
+        float filterDamping;
+        float filterEnvDepth;
+    };
+
+    // The patch and controller state for one MIDI channel. All parts draw their voices
+    // from the same pool.
+    struct Part
+    {
+        OscEngine oscEngine;
+        FilterRate filterRate;
+
+        // Changes to the continuous values that sounding voices read are smoothed: the ones
+        // read per control tick by smoothing, noiseMix and the output level per sample.
+        ControlSmoother smoothing;
+        LinearRamp noiseMixSmoother;
+
+        float noiseMix;        // target of noiseMixSmoother
+        float oscMix;
+        int unison;            // copies of the oscillator pair per note, 1 for none
+        float unisonDetune;    // semitones from the note to the outermost copies
+        float unisonSpread;    // stereo width of the copies, 0 to 1
+        float detune;
+        float tune;
+        float volumeTrim;
+        LinearRamp outputLevelSmoother;
+
+        float velocitySensitivity;
+        bool ignoreVelocity;
+
+        float envAttack;
+        float envDecay;
+        float envSustain;
+        float envRelease;
+
+        float lfoInc;
+        float vibrato;
+        float pwmDepth;
+        int lfoWave;
+
+        int glideMode;
+        float glideRate;
+        float glideBend;
+
+        int numVoices;
+        int prevNumVoices;
+        float filterKeyTracking;
+        float filterQ;
+        float resonanceCtl;
+        float filterLFODepth;
+        float pressure;
+        float filterCtl;
+        float filterAttack, filterDecay, filterSustain, filterRelease;
+        float filterEnvDepth;
+
+        // While morphing, the values above that make up a patch are mixed from morphA and
+        // morphB at every control tick in which morphAmount has moved. Parameter changes in
+        // between last until it moves again.
+        bool morphing;
+        float morphAmount;     // 0 plays morphA, 1 morphB
+        float morphMixed;      // the amount the values were last mixed for
+        PatchValues morphA;
+        PatchValues morphB;
+
+        float pitchBend;
+        bool sustainPedalPressed;
+        int lfoStep;
+        float lfo;
+        float modWheel;
+        int lastNote;
+        float filterZip;
 
+        // In mono mode the voice that plays, and behind it the keys that are still down.
+        // Past queuedCount the queue holds only zeros.
+        int monoVoice;
+        int queuedNotes[MAX_VOICES];
+        int queuedCount;
+
+        // The part's share of the sub-block being rendered.
+        std::vector<float> noiseBuffer;
+        std::vector<LFOTick> lfoTicks;
+        int tickCount;
+        int firstSlot;
+        int slotCount;
+    };
+
+    // With multi-timbral mode off every channel plays parts[0], otherwise channel n plays
+    // parts[n]. Switching stops all voices.
+    void setMultiTimbral(bool shouldBeMultiTimbral);
+    bool isMultiTimbral() const { return multiTimbral; }
+
+    // Where in the next render call the control values are read next.
+    int nextTickPosition() const { return std::max(parts[0].lfoStep - 1, 0); }
+
+    Part parts[NUM_PARTS];
+
+    // Everything that carries over from one render call to the next: the voices with their
+    // oscillators, filters and envelopes, the parts with their LFOs, glide, smoothers and
+    // controllers, the voice allocator and the noise generator. A synth allocated with the
+    // same sample rate, voice capacity and block size that restores a state carries on
+    // exactly where the state was saved, so a timeline can be rendered in pieces. The
+    // settings above are not part of it. Neither call is real-time safe.
+    struct State
+    {
+        static constexpr int VERSION = 1;  // goes up whenever what is saved changes
+
+        int version = 0;
+        float sampleRate = 0.0f;
+        int maxBlockSize = 0;
+        bool multiTimbral = false;
+        std::vector<Voice> voices;
+        VoiceAllocator voiceAllocator;
+        NoiseGenerator noiseGenerator;
+        std::vector<Part> parts;
+
+        // Where the pointers in the copies pointed, to point them at the restoring synth.
+        // Never read through.
+        const Part* sourceParts = nullptr;
+        const Wavetable* sourceWavetable = nullptr;
+        const float* sourceTables = nullptr;
+    };
+
+    void saveState(State& state) const;
+
+    // Returns false, and leaves the synth as it was, if the state does not fit this synth.
+    bool restoreState(const State& state);
+
+    // Reads the values that make up a patch from a part, or sets them.
+    static void capturePatch(const Part& part, PatchValues& values);
+    static void playPatch(Part& part, const PatchValues& values);
 
 private:
     float sampleRate;
-    float pitchBend;
-    bool sustainPedalPressed;
-    std::array<Voice, MAX_VOICES> voices;
+    bool multiTimbral;
+    std::vector<Voice> voices;
+    VoiceAllocator voiceAllocator;
     NoiseGenerator noiseGenerator;
-    int lfoStep;
-    float lfo;
-    float modWheel;
-    int lastNote;
-    float filterZip;
-
-    float calcPeriod(int v, int note) const;
-    void startVoice(int v, int note, int velocity);
-    void restartMonoVoice(int note, int velocity);
-    void noteOn(int note, int velocity);
-    void noteOff(int note);
-    int findFreeVoice() const;
-    void shiftQueuedNotes();
-    int nextQueuedNote();
-    void updateLFO();
+    Wavetable wavetable;
+    FilterTable filterTable;
+
+    // Scratch memory for the block renderers, sized in allocateResources.
+    int maxBlockSize;
+    int maxTicks;
+    juce::AudioBuffer<float> voiceBuffers;
+    std::vector<float> noiseBuffer;
+    std::vector<float> mixLeft;
+    std::vector<float> mixRight;
+    std::vector<float> sumLeft;
+    std::vector<float> sumRight;
+    std::vector<float> levels;    // output level of the part being mixed
+    std::vector<float> panLeft;   // per block slot, one value for each stretch between ticks
+    std::vector<float> panRight;
+
+    // The sub-block being rendered, shared with the render threads.
+    RenderThreadPool renderThreadPool;
+    std::vector<int> blockVoices;  // per block slot, grouped by part
+    float* const* voiceOutputs;    // per block slot
+    int blockSampleCount;
+
+    // In voiceBank mode each work item is a run of slots that all belong to one part.
+    struct BankGroup
+    {
+        int part;
+        int firstSlot;
+        int slotCount;
+    };
+    std::vector<BankGroup> bankGroups;
+
+    int partCount() const { return multiTimbral ? NUM_PARTS : 1; }
+    void resetPart(Part& part);
+    void controlChange(int p, uint8_t data1, uint8_t data2);
+    float calcPeriod(const Part& part, int v, int note) const;
+    void startVoice(int p, int v, int note, int velocity);
+    void restartMonoVoice(int p, int note, int velocity);
+    void noteOn(int p, int note, int velocity);
+    void noteOff(int p, int note);
+    int findFreeVoice(int p);
+    int countSteal(int v);
+    void shiftQueuedNotes(Part& part);
+    int nextQueuedNote(Part& part);
+    void trimQueuedNotes(Part& part);
+    void updateLFO(int p);
+    LFOTick nextLFOTick(Part& part);
+    void applyLFOTick(Voice& voice, const LFOTick& tick) const;
+    int scheduleLFOTicks(Part& part, int sampleCount);
+    void renderScalar(float* outputBufferLeft, float* outputBufferRight, int sampleCount);
+    void renderBlock(float* outputBufferLeft, float* outputBufferRight, int sampleCount);
+    void mixPart(const Part& part, int sampleCount);
+    void renderVoiceBlock(int v, int slot, int sampleCount);
+    void renderVoiceBankBlock(const Part& part, int firstSlot, int slotCount, int sampleCount);
+    static void renderVoiceJob(void* context, int slot);
+    static void renderVoiceBankJob(void* context, int group);
+
+    // A stereo voice writes its right channel to this buffer.
+    int rightChannel(int slot) const { return static_cast<int>(voices.size()) + slot; }
+
+    // The scratch buffers are indexed by the voice's slot in the block, not by voice number,
+    // so the memory touched scales with the voices that are sounding.
+    void recordPanning(int slot, const Voice& voice, int segment)
+    {
+        panLeft[static_cast<size_t>(slot * (maxTicks + 1) + segment)] = voice.panLeft;
+        panRight[static_cast<size_t>(slot * (maxTicks + 1) + segment)] = voice.panRight;
+    }
 
     void updatePeriod(Voice& voice) const
     {
-        voice.osc1.period = voice.period * pitchBend;
+        updatePeriod(voice, parts[voice.part].detune);
+    }
+
+    void updatePeriod(Voice& voice, float detune) const
+    {
+        const Part& part = parts[voice.part];
+        voice.osc1.period = voice.period * part.pitchBend;
         voice.osc2.period = voice.osc1.period * detune;
+        if (voice.isStereo())
+        {
+            voice.unison.follow(voice.osc1, voice.osc2);
+        }
+    }
+
+    // The BLIT needs a few samples per period, the tables only have to stay below Nyquist.
+    static float minPeriod(const Part& part)
+    {
+        return part.oscEngine == OscEngine::wavetable ? 2.0f : 6.0f;
     }
 
-    bool isPlyingLegatoStyle() const;
+    bool isPlyingLegatoStyle(int p) const;
 };
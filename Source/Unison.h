@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "OscillatorLanes.h"
+
+// The stacked oscillator pairs of a voice in unison mode. Every copy of the pair runs at a
+// slightly different period and has its own place in the stereo field. The copies are summed
+// before the filter and envelope of the voice, so a thick note costs one filter and one
+// envelope instead of a whole voice per copy.
+//
+// The voice's own osc1 and osc2 keep the pitch, modulation, level and engine of the note,
+// and follow hands those on to the copies.
+struct Unison
+{
+    static constexpr int MAX_COPIES = 16;
+    static constexpr int LANES = SimdFloat::size;
+
+    int count = 1;  // copies of the oscillator pair, 1 when unison is off
+
+    Oscillator osc1[MAX_COPIES];
+    Oscillator osc2[MAX_COPIES];
+    float ratio[MAX_COPIES];       // period of each copy relative to the note
+    float gainLeft[MAX_COPIES];
+    float gainRight[MAX_COPIES];
+
+    void reset()
+    {
+        for (int c = 0; c < MAX_COPIES; ++c)
+        {
+            osc1[c].reset();
+            osc2[c].reset();
+        }
+    }
+
+    // Spreads the copies evenly over detune semitones either side of the note and pans them
+    // from left to right over the given width. drift is the offset in semitones by which
+    // neighbouring copies differ anyway, like the voices in Synth::calcPeriod.
+    void setup(int copies, float detune, float spread, float drift)
+    {
+        count = std::clamp(copies, 1, MAX_COPIES);
+
+        // Uncorrelated copies add up to the square root of their count.
+        const float level = 1.0f / std::sqrt(static_cast<float>(count));
+        for (int c = 0; c < MAX_COPIES; ++c)
+        {
+            float position = count > 1 ? 2.0f * static_cast<float>(c) / static_cast<float>(count - 1) - 1.0f : 0.0f;
+            float pan = spread * position;
+            ratio[c] = FastMath::exp(-0.05776226505f * (detune * position + drift * static_cast<float>(c % 8)));
+            gainLeft[c] = c < count ? 1.4142135f * level * FastMath::sin(PI_OVER_4 * (1.0f - pan)) : 0.0f;
+            gainRight[c] = c < count ? 1.4142135f * level * FastMath::sin(PI_OVER_4 * (1.0f + pan)) : 0.0f;
+        }
+    }
+
+    void follow(const Oscillator& source1, const Oscillator& source2)
+    {
+        if (osc1[0].wavetable != source1.wavetable)
+        {
+            // The state of one engine means nothing to the other.
+            for (int c = 0; c < MAX_COPIES; ++c)
+            {
+                osc1[c].reset();
+                osc2[c].reset();
+                osc1[c].wavetable = source1.wavetable;
+                osc2[c].wavetable = source2.wavetable;
+            }
+        }
+
+        for (int c = 0; c < count; ++c)
+        {
+            osc1[c].period = source1.period * ratio[c];
+            osc1[c].modulation = source1.modulation;
+            osc1[c].amplitude = source1.amplitude;
+            osc2[c].period = source2.period * ratio[c];
+            osc2[c].modulation = source2.modulation;
+            osc2[c].amplitude = source2.amplitude;
+        }
+    }
+
+    void rebase(const Wavetable* fromWavetable, const float* fromTables, const Wavetable& to)
+    {
+        for (int c = 0; c < MAX_COPIES; ++c)
+        {
+            osc1[c].rebase(fromWavetable, fromTables, to);
+            osc2[c].rebase(fromWavetable, fromTables, to);
+        }
+    }
+
+    // Oscillator::squareWave for every copy, at the period of that copy.
+    void squareWave(float newPeriod)
+    {
+        for (int c = 0; c < count; ++c)
+        {
+            osc2[c].squareWave(osc1[c], newPeriod * ratio[c]);
+        }
+    }
+
+    // The difference of the two oscillators of every copy, summed into one sample per channel.
+    void renderSample(float& left, float& right)
+    {
+        left = 0.0f;
+        right = 0.0f;
+        for (int c = 0; c < count; ++c)
+        {
+            float sample = osc1[c].nextSample() - osc2[c].nextSample();
+            left += gainLeft[c] * sample;
+            right += gainRight[c] * sample;
+        }
+    }
+
+    // Block version of renderSample. The BLIT copies run a SIMD lane each, the tables are
+    // read one copy at a time.
+    void render(float* left, float* right, int sampleCount)
+    {
+        std::fill(left, left + sampleCount, 0.0f);
+        std::fill(right, right + sampleCount, 0.0f);
+
+        if (osc1[0].wavetable != nullptr)
+        {
+            renderTables(left, right, sampleCount);
+            return;
+        }
+
+        for (int first = 0; first < count; first += LANES)
+        {
+            Oscillator* oscs1[LANES];
+            Oscillator* oscs2[LANES];
+            LaneArray gl{}, gr{}, outLeft, outRight;
+            int used = std::min(LANES, count - first);
+            for (int lane = 0; lane < used; ++lane)
+            {
+                oscs1[lane] = &osc1[first + lane];
+                oscs2[lane] = &osc2[first + lane];
+                gl.x[lane] = gainLeft[first + lane];
+                gr.x[lane] = gainRight[first + lane];
+            }
+
+            OscillatorLanes lanes1, lanes2;
+            lanes1.gather(oscs1, used);
+            lanes2.gather(oscs2, used);
+            SimdFloat laneGainLeft = SimdFloat::load(gl.x);
+            SimdFloat laneGainRight = SimdFloat::load(gr.x);
+            int usedLanes = (1 << used) - 1;
+
+            for (int sample = 0; sample < sampleCount; ++sample)
+            {
+                SimdFloat difference = lanes1.nextSample(usedLanes) - lanes2.nextSample(usedLanes);
+                (difference * laneGainLeft).store(outLeft.x);
+                (difference * laneGainRight).store(outRight.x);
+
+                // Lanes without a copy have no gain, so all of them can be added up.
+                float sumLeft = 0.0f;
+                float sumRight = 0.0f;
+                for (int lane = 0; lane < LANES; ++lane)
+                {
+                    sumLeft += outLeft.x[lane];
+                    sumRight += outRight.x[lane];
+                }
+                left[sample] += sumLeft;
+                right[sample] += sumRight;
+            }
+
+            lanes1.scatter(oscs1, used);
+            lanes2.scatter(oscs2, used);
+        }
+    }
+
+private:
+    void renderTables(float* left, float* right, int sampleCount)
+    {
+        for (int c = 0; c < count; ++c)
+        {
+            Oscillator o1 = osc1[c];
+            Oscillator o2 = osc2[c];
+            const float gl = gainLeft[c];
+            const float gr = gainRight[c];
+
+            for (int sample = 0; sample < sampleCount; ++sample)
+            {
+                float difference = o1.nextTableSample() - o2.nextTableSample();
+                left[sample] += gl * difference;
+                right[sample] += gr * difference;
+            }
+
+            osc1[c] = o1;
+            osc2[c] = o2;
+        }
+    }
+};
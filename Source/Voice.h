@@ -2,12 +2,15 @@
 #include "Oscillator.h"
 #include "Envelope.h"
 #include "Filter.h"
+#include "FilterTable.h"
+#include "Unison.h"
 
 struct Voice
 {
     Oscillator osc1;
     Oscillator osc2;
 
+    int part;  // the Synth part playing this voice
     int note;
     float saw;
     Envelope env;
@@ -19,16 +22,24 @@ struct Voice
     float panLeft, panRight;
 
     Filter filter;
-    float cutoff;
+    float logCutoff;      // natural log of the cutoff in Hz before modulation
     float filterMod;
-    float filterQ;
+    float filterDamping;  // 1/Q
+    bool rampFilter;      // coefficients move every sample instead of once per control tick
     Envelope filterEnv;
     float filterEnvDepth;
 
+    // With more than one copy the voice is stereo from the oscillators on. The right channel
+    // shares the filter coefficients and the envelope with the left one.
+    Unison unison;
+    float sawRight;
+    float ic1eqRight, ic2eqRight;  // filter state of the right channel
+
     void reset()
     {
         osc1.reset();
         osc2.reset();
+        part = 0;
         note = 0;
         saw = 0.0f;
         env.reset();
@@ -36,6 +47,20 @@ struct Voice
         panning = targetPanning = 0.0f;
         filter.reset();
         filterEnv.reset();
+        rampFilter = false;
+        unison.reset();
+        sawRight = 0.0f;
+        ic1eqRight = ic2eqRight = 0.0f;
+    }
+
+    bool isStereo() const { return unison.count > 1; }
+
+    // See Oscillator::rebase.
+    void rebase(const Wavetable* fromWavetable, const float* fromTables, const Wavetable& to)
+    {
+        osc1.rebase(fromWavetable, fromTables, to);
+        osc2.rebase(fromWavetable, fromTables, to);
+        unison.rebase(fromWavetable, fromTables, to);
     }
 
     void release()
@@ -47,33 +72,159 @@ struct Voice
     void updatePanning()
     {
         panning += glideRate * (targetPanning - panning);
-        panLeft = std::sin(PI_OVER_4 * (1.0f - panning));
-        panRight = std::sin(PI_OVER_4 * (1.0f + panning));
+        panLeft = FastMath::sin(PI_OVER_4 * (1.0f - panning));
+        panRight = FastMath::sin(PI_OVER_4 * (1.0f + panning));
     }
 
     float render(float input)
     {
-        float sample1 = osc1.nextSample();
-        float sample2 = osc2.nextSample();
+        float output = renderFrom(osc1.nextSample(), osc2.nextSample(), input, saw, filter, rampFilter);
+
+        float envelope = env.nextValue();
+        return output * envelope;
+    }
+
+    // Everything up to the envelope.
+    static JX11_FORCEINLINE float renderFrom(float sample1, float sample2, float input,
+                                             float& saw, Filter& filter, bool rampFilter)
+    {
         saw = saw * 0.997f + sample1 - sample2;
 
         float output = saw + input;
 
-        output = filter.render(output);
+        return rampFilter ? filter.renderRamped(output) : filter.render(output);
+    }
+
+    // render for a stereo voice.
+    void renderStereo(float input, float& left, float& right)
+    {
+        unison.renderSample(left, right);
+        StereoState state { saw, sawRight, ic1eqRight, ic2eqRight };
+        filterStereo(input, left, right, state, filter, rampFilter);
+        saw = state.sawLeft;
+        sawRight = state.sawRight;
+        ic1eqRight = state.ic1eqRight;
+        ic2eqRight = state.ic2eqRight;
 
         float envelope = env.nextValue();
-        return output * envelope;
+        left *= envelope;
+        right *= envelope;
+    }
+
+    // renderBlock for a stereo voice. The copies go into the output buffers first and are
+    // filtered in place, a stretch at a time so the envelope fits on the stack.
+    int renderStereoBlock(const float* input, float* left, float* right, int sampleCount)
+    {
+        constexpr int STRETCH = 64;
+        int sample = 0;
+        while (sample < sampleCount)
+        {
+            float envelope[STRETCH];
+            int length = std::min(STRETCH, sampleCount - sample);
+            int count = env.renderBlock(envelope, length);
+            unison.render(left + sample, right + sample, count);
+
+            Filter f = filter;
+            StereoState state { saw, sawRight, ic1eqRight, ic2eqRight };
+            for (int i = 0; i < count; ++i)
+            {
+                float l = left[sample + i];
+                float r = right[sample + i];
+                filterStereo(input[sample + i], l, r, state, f, rampFilter);
+                left[sample + i] = l * envelope[i];
+                right[sample + i] = r * envelope[i];
+            }
+            filter = f;
+            saw = state.sawLeft;
+            sawRight = state.sawRight;
+            ic1eqRight = state.ic1eqRight;
+            ic2eqRight = state.ic2eqRight;
+
+            sample += count;
+            if (count < length) { break; }
+        }
+        return sample;
+    }
+
+    struct StereoState
+    {
+        float sawLeft, sawRight;
+        float ic1eqRight, ic2eqRight;
+    };
+
+    // renderFrom for the summed copies of both channels.
+    static JX11_FORCEINLINE void filterStereo(float input, float& left, float& right,
+                                              StereoState& state, Filter& filter, bool rampFilter)
+    {
+        state.sawLeft = state.sawLeft * 0.997f + left;
+        state.sawRight = state.sawRight * 0.997f + right;
+
+        left = rampFilter ? filter.renderRamped(state.sawLeft + input) : filter.render(state.sawLeft + input);
+        right = filter.render(state.sawRight + input, state.ic1eqRight, state.ic2eqRight);
+    }
+
+    // Renders up to sampleCount samples into output and returns how many were rendered,
+    // which is fewer when the envelope falls silent on the way. The envelope is worked out
+    // for the whole block first, so it is off by rounding from what render would give.
+    int renderBlock(const float* input, float* output, int sampleCount)
+    {
+        if (rampFilter)
+        {
+            return osc1.wavetable != nullptr ? renderLoop<true, true>(input, output, sampleCount)
+                                             : renderLoop<false, true>(input, output, sampleCount);
+        }
+        return osc1.wavetable != nullptr ? renderLoop<true, false>(input, output, sampleCount)
+                                         : renderLoop<false, false>(input, output, sampleCount);
     }
 
-    void updateLFO()
+    // Local copies of the state that changes every sample let the compiler keep it in
+    // registers, since stores to the output buffer cannot alias them.
+    template<bool useTables, bool ramped>
+    JX11_FORCEINLINE int renderLoop(const float* input, float* output, int sampleCount)
+    {
+        // The envelope goes into output first and each sample is multiplied in place.
+        int count = env.renderBlock(output, sampleCount);
+
+        Oscillator o1 = osc1;
+        Oscillator o2 = osc2;
+        Filter f = filter;
+        float s = saw;
+
+        for (int sample = 0; sample < count; ++sample)
+        {
+            float sample1 = useTables ? o1.nextTableSample() : o1.nextBlitSample();
+            float sample2 = useTables ? o2.nextTableSample() : o2.nextBlitSample();
+            output[sample] = renderFrom(sample1, sample2, input[sample], s, f, ramped) * output[sample];
+        }
+
+        osc1 = o1;
+        osc2 = o2;
+        filter = f;
+        saw = s;
+        return count;
+    }
+
+    // With a filterRamp above zero the filter glides to the new coefficients at that
+    // fraction of the way per sample, otherwise it jumps to them.
+    void updateLFO(const FilterTable& filterTable, float filterRamp)
     {
         period += glideRate * (target - period);
         updatePanning();
 
         float fenv = filterEnv.nextValue();
 
-        float modulatedCutoff = cutoff * std::exp(filterMod + filterEnvDepth * fenv);
-        modulatedCutoff = std::clamp(modulatedCutoff, 30.0f, 20000.0f);
-        filter.updateCoefficients(modulatedCutoff, filterQ);
+        // The modulation is applied as a factor on the cutoff, which is a sum in the log domain.
+        float g, a1;
+        filterTable.lookup(logCutoff + filterMod + filterEnvDepth * fenv, filterDamping, g, a1);
+
+        rampFilter = filterRamp > 0.0f;
+        if (rampFilter)
+        {
+            filter.rampCoefficients(g, a1, filterDamping, filterRamp);
+        }
+        else
+        {
+            filter.setCoefficients(g, a1);
+        }
     }
 };
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Keeps track of which voices are sounding and which one to take for a new note.
+//
+// The sounding voices sit in a binary heap with the best voice to steal on top: released
+// voices before held ones, and the longest released or longest held first. The heap also
+// serves as the list of sounding voices for the render loops. Its order only changes when
+// notes start, end or are released, never while a block is being rendered.
+class VoiceAllocator
+{
+public:
+    // Sizes the storage for this many voices. Not real-time safe.
+    void allocate(int capacity)
+    {
+        heap.reserve(static_cast<size_t>(capacity));
+        freeVoices.reserve(static_cast<size_t>(capacity));
+        heapPosition.assign(static_cast<size_t>(capacity), -1);
+        freePosition.assign(static_cast<size_t>(capacity), -1);
+        keys.assign(static_cast<size_t>(capacity), 0);
+        reset();
+    }
+
+    // Forgets all sounding voices.
+    void reset()
+    {
+        for (int v : heap)
+        {
+            heapPosition[static_cast<size_t>(v)] = -1;
+        }
+        heap.clear();
+        counter = 0;
+        setLimit(limit);
+    }
+
+    // Only voices below the limit are handed out as free voices.
+    void setLimit(int newLimit)
+    {
+        limit = std::min(newLimit, static_cast<int>(heapPosition.size()));
+
+        for (int v : freeVoices)
+        {
+            freePosition[static_cast<size_t>(v)] = -1;
+        }
+        freeVoices.clear();
+
+        // Backwards, so that the lowest voice is handed out first.
+        for (int v = limit - 1; v >= 0; --v)
+        {
+            if (!isSounding(v))
+            {
+                pushFree(v);
+            }
+        }
+    }
+
+    int getLimit() const { return limit; }
+
+    int size() const { return static_cast<int>(heap.size()); }
+    int operator[](int i) const { return heap[static_cast<size_t>(i)]; }
+
+    bool isSounding(int v) const { return heapPosition[static_cast<size_t>(v)] >= 0; }
+
+    // A voice that is not sounding, or -1 when all voices below the limit are taken.
+    int nextFree() const
+    {
+        return freeVoices.empty() ? -1 : freeVoices.back();
+    }
+
+    // The voice to take over when there is no free one.
+    int victim() const
+    {
+        return heap.empty() ? 0 : heap.front();
+    }
+
+    // The voice to take over among the sounding voices that pass the test, or -1 if none does.
+    // This one goes through the whole heap.
+    template<typename Predicate>
+    int victim(Predicate test) const
+    {
+        int best = -1;
+        for (int v : heap)
+        {
+            if (test(v) && (best < 0 || keys[static_cast<size_t>(v)] < keys[static_cast<size_t>(best)]))
+            {
+                best = v;
+            }
+        }
+        return best;
+    }
+
+    // Voice v starts a note, whether it was free, stolen or retriggered.
+    void start(int v)
+    {
+        if (freePosition[static_cast<size_t>(v)] >= 0)
+        {
+            removeFree(v);
+        }
+        setKey(v, HELD | ++counter);
+    }
+
+    void release(int v)
+    {
+        if (isSounding(v) && (keys[static_cast<size_t>(v)] & HELD) != 0)
+        {
+            setKey(v, ++counter);
+        }
+    }
+
+    // Voice v fell silent.
+    void stop(int v)
+    {
+        int i = heapPosition[static_cast<size_t>(v)];
+        if (i < 0) { return; }
+
+        int last = heap.back();
+        heap.pop_back();
+        heapPosition[static_cast<size_t>(v)] = -1;
+        if (last != v)
+        {
+            place(last, i);
+            siftDown(siftUp(i));
+        }
+
+        if (v < limit)
+        {
+            pushFree(v);
+        }
+    }
+
+private:
+    static constexpr uint64_t HELD = uint64_t(1) << 63;
+
+    void setKey(int v, uint64_t key)
+    {
+        keys[static_cast<size_t>(v)] = key;
+        int i = heapPosition[static_cast<size_t>(v)];
+        if (i < 0)
+        {
+            i = size();
+            heap.push_back(v);
+            heapPosition[static_cast<size_t>(v)] = i;
+        }
+        siftDown(siftUp(i));
+    }
+
+    uint64_t keyAt(int i) const
+    {
+        return keys[static_cast<size_t>(heap[static_cast<size_t>(i)])];
+    }
+
+    void place(int v, int i)
+    {
+        heap[static_cast<size_t>(i)] = v;
+        heapPosition[static_cast<size_t>(v)] = i;
+    }
+
+    int siftUp(int i)
+    {
+        int v = heap[static_cast<size_t>(i)];
+        uint64_t key = keys[static_cast<size_t>(v)];
+        while (i > 0)
+        {
+            int parent = (i - 1) / 2;
+            if (keyAt(parent) <= key) { break; }
+            place(heap[static_cast<size_t>(parent)], i);
+            i = parent;
+        }
+        place(v, i);
+        return i;
+    }
+
+    void siftDown(int i)
+    {
+        int v = heap[static_cast<size_t>(i)];
+        uint64_t key = keys[static_cast<size_t>(v)];
+        int count = size();
+        while (true)
+        {
+            int child = 2 * i + 1;
+            if (child >= count) { break; }
+            if (child + 1 < count && keyAt(child + 1) < keyAt(child)) { ++child; }
+            if (key <= keyAt(child)) { break; }
+            place(heap[static_cast<size_t>(child)], i);
+            i = child;
+        }
+        place(v, i);
+    }
+
+    void pushFree(int v)
+    {
+        freePosition[static_cast<size_t>(v)] = static_cast<int>(freeVoices.size());
+        freeVoices.push_back(v);
+    }
+
+    void removeFree(int v)
+    {
+        int i = freePosition[static_cast<size_t>(v)];
+        int last = freeVoices.back();
+        freeVoices[static_cast<size_t>(i)] = last;
+        freePosition[static_cast<size_t>(last)] = i;
+        freeVoices.pop_back();
+        freePosition[static_cast<size_t>(v)] = -1;
+    }
+
+    std::vector<int> heap;
+    std::vector<int> heapPosition;   // per voice, -1 when not sounding
+    std::vector<uint64_t> keys;      // per voice, smaller is stolen first
+    std::vector<int> freeVoices;
+    std::vector<int> freePosition;   // per voice, -1 when not in freeVoices
+    uint64_t counter = 0;
+    int limit = 0;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include "FastMath.h"
+#include "OscillatorLanes.h"
+#include "Voice.h"
+
+// Renders several voices at once, one voice per SIMD lane. At the start of a segment the
+// oscillator, filter and envelope state of each voice is copied into structure-of-arrays
+// lanes, and copied back when the segment is done, so the Voice objects stay the owners
+// of the state and everything outside the render loop keeps working on them.
+//
+// The lanes run exactly the operations of Voice::render in the same order, so the output
+// matches the scalar path to within 1e-6 (it is bit-identical unless the compiler fuses
+// multiply-adds differently in the two paths).
+struct VoiceBank
+{
+    static constexpr int LANES = SimdFloat::size;
+
+    // Renders sampleCount samples of each voice into its own output buffer. A voice whose
+    // envelope falls silent stops at that sample and the rest of its buffer is zeroed, just
+    // like the scalar loop skips inactive voices.
+    static void render(Voice* const* voices, float* const* outputs, int count,
+                       const float* noise, int sampleCount)
+    {
+        for (int first = 0; first < count; first += LANES)
+        {
+            Voice* group[LANES];
+            float* groupOutputs[LANES];
+            int groupSize = std::min(LANES, count - first);
+            for (int lane = 0; lane < groupSize; ++lane)
+            {
+                group[lane] = voices[first + lane];
+                groupOutputs[lane] = outputs[first + lane];
+            }
+            renderGroup(group, groupOutputs, groupSize, noise, sampleCount);
+        }
+    }
+
+private:
+    struct VoiceLanes
+    {
+        OscillatorLanes osc1, osc2;
+        SimdFloat saw;
+        SimdFloat a1, a2, a3, ic1eq, ic2eq;
+        SimdFloat g, k, gStep, ramp;
+        SimdFloat level, multiplier, target, decayMultiplier, sustainLevel;
+        bool anyRamp;
+
+        void gather(Voice* const* voices, int count)
+        {
+            Oscillator* oscs1[LANES];
+            Oscillator* oscs2[LANES];
+            LaneArray sw{}, f1{}, f2{}, f3{}, c1{}, c2{}, l{}, mul{}, t{}, dm{}, sl{};
+            LaneArray fg{}, fk{}, gs{}, r{};
+            anyRamp = false;
+            for (int lane = 0; lane < count; ++lane)
+            {
+                Voice& voice = *voices[lane];
+                oscs1[lane] = &voice.osc1;
+                oscs2[lane] = &voice.osc2;
+                sw.x[lane] = voice.saw;
+                f1.x[lane] = voice.filter.a1;
+                f2.x[lane] = voice.filter.a2;
+                f3.x[lane] = voice.filter.a3;
+                c1.x[lane] = voice.filter.ic1eq;
+                c2.x[lane] = voice.filter.ic2eq;
+                l.x[lane] = voice.env.level;
+                mul.x[lane] = voice.env.multiplier;
+                t.x[lane] = voice.env.target;
+                dm.x[lane] = voice.env.decayMultiplier;
+                sl.x[lane] = voice.env.sustainLevel;
+                fg.x[lane] = voice.filter.g;
+                fk.x[lane] = voice.filter.k;
+                gs.x[lane] = voice.filter.gStep;
+                r.x[lane] = voice.rampFilter ? 1.0f : 0.0f;
+                anyRamp = anyRamp || voice.rampFilter;
+            }
+            osc1.gather(oscs1, count);
+            osc2.gather(oscs2, count);
+            saw = SimdFloat::load(sw.x);
+            a1 = SimdFloat::load(f1.x);
+            a2 = SimdFloat::load(f2.x);
+            a3 = SimdFloat::load(f3.x);
+            ic1eq = SimdFloat::load(c1.x);
+            ic2eq = SimdFloat::load(c2.x);
+            level = SimdFloat::load(l.x);
+            multiplier = SimdFloat::load(mul.x);
+            target = SimdFloat::load(t.x);
+            decayMultiplier = SimdFloat::load(dm.x);
+            sustainLevel = SimdFloat::load(sl.x);
+            g = SimdFloat::load(fg.x);
+            k = SimdFloat::load(fk.x);
+            gStep = SimdFloat::load(gs.x);
+            ramp = SimdFloat::greaterThan(SimdFloat::load(r.x), SimdFloat::expand(0.0f));
+        }
+
+        void scatter(Voice* const* voices, int count) const
+        {
+            Oscillator* oscs1[LANES];
+            Oscillator* oscs2[LANES];
+            LaneArray sw, c1, c2, l, mul, t;
+            LaneArray f1, f2, f3, fg;
+            saw.store(sw.x);
+            ic1eq.store(c1.x);
+            ic2eq.store(c2.x);
+            level.store(l.x);
+            multiplier.store(mul.x);
+            target.store(t.x);
+            if (anyRamp)
+            {
+                a1.store(f1.x);
+                a2.store(f2.x);
+                a3.store(f3.x);
+                g.store(fg.x);
+            }
+            for (int lane = 0; lane < count; ++lane)
+            {
+                Voice& voice = *voices[lane];
+                oscs1[lane] = &voice.osc1;
+                oscs2[lane] = &voice.osc2;
+                voice.saw = sw.x[lane];
+                voice.filter.ic1eq = c1.x[lane];
+                voice.filter.ic2eq = c2.x[lane];
+                voice.env.level = l.x[lane];
+                voice.env.multiplier = mul.x[lane];
+                voice.env.target = t.x[lane];
+                if (anyRamp)
+                {
+                    voice.filter.a1 = f1.x[lane];
+                    voice.filter.a2 = f2.x[lane];
+                    voice.filter.a3 = f3.x[lane];
+                    voice.filter.g = fg.x[lane];
+                }
+            }
+            osc1.scatter(oscs1, count);
+            osc2.scatter(oscs2, count);
+        }
+
+        SimdFloat render(SimdFloat input, int usedLanes)
+        {
+            SimdFloat sample1 = osc1.nextSample(usedLanes);
+            SimdFloat sample2 = osc2.nextSample(usedLanes);
+            saw = saw * SimdFloat::expand(0.997f) + sample1 - sample2;
+
+            SimdFloat x = saw + input;
+
+            // Filter::renderRamped for the lanes that ramp. The others have no step, so their
+            // g stays put and a2 and a3 come out as they were.
+            if (anyRamp)
+            {
+                g = g + gStep;
+                SimdFloat d = 1.0f + g * (g + k);
+                SimdFloat newA1 = a1 * (2.0f - a1 * d);
+                newA1 = newA1 * (2.0f - newA1 * d);
+                a1 = SimdFloat::select(ramp, newA1, a1);
+                a2 = g * a1;
+                a3 = g * a2;
+            }
+
+            SimdFloat v3 = x - ic2eq;
+            SimdFloat v1 = a1 * ic1eq + a2 * v3;
+            SimdFloat v2 = ic2eq + a2 * ic1eq + a3 * v3;
+            SimdFloat two = SimdFloat::expand(2.0f);
+            ic1eq = two * v1 - ic1eq;
+            ic2eq = two * v2 - ic2eq;
+
+            level = multiplier * (level - target) + target;
+            SimdFloat nextStage = SimdFloat::greaterThan(level + target, SimdFloat::expand(3.0f));
+            multiplier = SimdFloat::select(nextStage, decayMultiplier, multiplier);
+            target = SimdFloat::select(nextStage, sustainLevel, target);
+
+            return v2 * level;
+        }
+    };
+
+    static void renderGroup(Voice** voices, float** outputs, int count, const float* noise, int sampleCount)
+    {
+        VoiceLanes lanes;
+        LaneArray out;
+        int sample = 0;
+
+        while (count > 0 && sample < sampleCount)
+        {
+            lanes.gather(voices, count);
+            int usedLanes = (1 << count) - 1;
+            int silent = 0;
+
+            for (; sample < sampleCount; ++sample)
+            {
+                silent = SimdFloat::bitmask(SimdFloat::lessOrEqual(lanes.level, SimdFloat::expand(SILENCE))) & usedLanes;
+                if (silent != 0) { break; }
+
+                lanes.render(SimdFloat::expand(noise[sample]), usedLanes).store(out.x);
+                for (int lane = 0; lane < count; ++lane)
+                {
+                    outputs[lane][sample] = out.x[lane];
+                }
+            }
+
+            lanes.scatter(voices, count);
+
+            // Drop the voices that went silent and carry on with the others.
+            int kept = 0;
+            for (int lane = 0; lane < count; ++lane)
+            {
+                if ((silent & (1 << lane)) != 0)
+                {
+                    std::fill(outputs[lane] + sample, outputs[lane] + sampleCount, 0.0f);
+                }
+                else
+                {
+                    voices[kept] = voices[lane];
+                    outputs[kept] = outputs[lane];
+                    ++kept;
+                }
+            }
+            count = kept;
+        }
+    }
+};
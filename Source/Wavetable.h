@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Band-limited impulse trains for the wavetable oscillator, one table per octave.
+// Table l holds the first 2^l harmonics of a train without DC, which the voice
+// integrates into a saw, or into a square/PWM wave by subtracting two trains.
+class Wavetable
+{
+public:
+    static constexpr int SIZE = 4096;
+    static constexpr int LEVELS = 10;
+
+    // The tables do not depend on the sample rate, so this only does work the first time.
+    void build()
+    {
+        if (!tables.empty()) { return; }
+
+        std::vector<double> cosine(SIZE);
+        for (int i = 0; i < SIZE; ++i)
+        {
+            cosine[static_cast<size_t>(i)] = std::cos(6.283185307179586 * i / SIZE);
+        }
+
+        std::vector<double> sum(SIZE, 0.0);
+        tables.resize(static_cast<size_t>(LEVELS * (SIZE + 1)));
+
+        int harmonic = 0;
+        for (int level = 0; level < LEVELS; ++level)
+        {
+            // Each octave adds the harmonics the previous table left out.
+            while (harmonic < (1 << level))
+            {
+                ++harmonic;
+                for (int i = 0; i < SIZE; ++i)
+                {
+                    sum[static_cast<size_t>(i)] += cosine[static_cast<size_t>((harmonic * i) % SIZE)];
+                }
+            }
+
+            float* table = tables.data() + level * (SIZE + 1);
+            for (int i = 0; i < SIZE; ++i)
+            {
+                table[i] = static_cast<float>(sum[static_cast<size_t>(i)]);
+            }
+            table[SIZE] = table[0];  // guard point for the interpolation
+        }
+    }
+
+    // The table with the most harmonics that all stay below Nyquist at this period in samples.
+    const float* forPeriod(float period) const
+    {
+        int level = std::clamp(std::ilogb(period * 0.5f), 0, LEVELS - 1);
+        return tables.data() + level * (SIZE + 1);
+    }
+
+    const float* data() const { return tables.data(); }
+
+private:
+    std::vector<float> tables;
+};
@@ -0,0 +1,75 @@
+// Makes preset bank files for the plugin.
+//
+//     JX11BankTool factory <bank>                  the factory presets
+//     JX11BankTool states <bank> <state files...>  one preset per saved plugin state
+//     JX11BankTool list <bank>                     prints the presets of a bank
+//
+// A state file holds what getStateInformation saved: the binary state, or the XML state of an
+// earlier version, in JUCE's binary wrapper or as text. The plugin reads it through the same
+// SavedState. The preset takes its name from the file name.
+
+#include <JuceHeader.h>
+#include "FactoryPresets.h"
+#include "PresetBank.h"
+#include <iostream>
+#include <vector>
+
+// The state reads in place, so data has to outlive it.
+static bool readState(const juce::File& file, juce::MemoryBlock& data, SavedState& state)
+{
+    return file.loadFileAsData(data) && state.read(data.getData(), data.getSize());
+}
+
+static bool writeBank(const juce::File& file, const Preset* presets, int count)
+{
+    file.deleteFile();
+    juce::FileOutputStream output(file);
+    return output.openedOk() && PresetBank::write(output, presets, count);
+}
+
+static int fail(const juce::String& message)
+{
+    std::cerr << message << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i) { args.add(argv[i]); }
+
+    if (args.size() == 2 && args[0] == "factory")
+    {
+        juce::File bank = juce::File::getCurrentWorkingDirectory().getChildFile(args[1]);
+        return writeBank(bank, factoryPresets, NUM_FACTORY_PRESETS) ? 0 : fail("Cannot write " + bank.getFullPathName());
+    }
+
+    if (args.size() >= 3 && args[0] == "states")
+    {
+        std::vector<Preset> presets;
+        for (int i = 2; i < args.size(); ++i)
+        {
+            juce::File file = juce::File::getCurrentWorkingDirectory().getChildFile(args[i]);
+            juce::MemoryBlock data;
+            SavedState state;
+            if (!readState(file, data, state)) { return fail("Not a plugin state: " + file.getFullPathName()); }
+            presets.push_back(PresetBank::fromState(state, file.getFileNameWithoutExtension()));
+        }
+
+        juce::File bank = juce::File::getCurrentWorkingDirectory().getChildFile(args[1]);
+        return writeBank(bank, presets.data(), static_cast<int>(presets.size())) ? 0 : fail("Cannot write " + bank.getFullPathName());
+    }
+
+    if (args.size() == 2 && args[0] == "list")
+    {
+        PresetBank bank;
+        if (!bank.load(juce::File::getCurrentWorkingDirectory().getChildFile(args[1]))) { return fail("Not a preset bank: " + args[1]); }
+        for (int i = 0; i < bank.size(); ++i)
+        {
+            std::cout << i << "\t" << bank.getName(i) << "\n";
+        }
+        return 0;
+    }
+
+    return fail("Usage: JX11BankTool factory <bank> | states <bank> <state files...> | list <bank>");
+}
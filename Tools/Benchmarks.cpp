@@ -0,0 +1,511 @@
+// Times the DSP building blocks one at a time, and the whole synth with every factory preset.
+//
+//     JX11Benchmarks [--filter text] [--time seconds] [--csv file] [--compare file] [--threshold percent]
+//
+//     --filter     only the benchmarks whose name contains the text
+//     --time       seconds spent on each benchmark, 0.05 by default
+//     --csv        also writes the results to a file, one "name,ns per sample,real-time factor"
+//                  line per benchmark, which --compare reads back
+//     --compare    compares with results written earlier and fails if a benchmark got slower
+//                  by more than --threshold percent, 10 by default
+//
+// Times are the best of several runs, in nanoseconds per sample, or per stereo sample frame
+// for the synth. The real-time factor is how many times faster than real time at 48 kHz
+// that is. Exits with 1 if no benchmark matches the filter or one measured no time, which
+// the build's test run, with a very short --time, uses to check that every benchmark works.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "Voice.h"
+#include "NoiseGenerator.h"
+#include "FastMath.h"
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <vector>
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr int BLOCK_SIZE = 512;
+static constexpr int RUNS = 5;
+
+struct Options
+{
+    juce::String filter;
+    double seconds = 0.05;
+    juce::File csv;
+    juce::File baseline;
+    double threshold = 10.0;
+};
+
+struct Measurement
+{
+    juce::String name;
+    double nsPerSample;
+    double realTimeFactor;
+};
+
+// Keeps the compiler from leaving out work whose result is never used.
+static volatile float sink;
+
+// Runs the batch, which does samplesPerBatch samples, for about the given time split over
+// RUNS runs, and takes the best run.
+static Measurement measure(const juce::String& name, double seconds, int samplesPerBatch, const std::function<void()>& batch)
+{
+    batch();  // warm up
+
+    double best = 0.0;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        juce::int64 samples = 0;
+        auto start = juce::Time::getHighResolutionTicks();
+        double elapsed = 0.0;
+        do
+        {
+            batch();
+            samples += samplesPerBatch;
+            elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        }
+        while (elapsed < seconds / RUNS);
+
+        double ns = 1e9 * elapsed / static_cast<double>(samples);
+        best = run == 0 ? ns : std::min(best, ns);
+    }
+    return { name, best, 1e9 / (best * SAMPLE_RATE) };
+}
+
+static float envelopeMultiplier(double seconds)
+{
+    return static_cast<float>(std::exp(-1.0 / (seconds * SAMPLE_RATE)));
+}
+
+static void setUpEnvelope(Envelope& env)
+{
+    env.reset();
+    env.attackMultiplier = envelopeMultiplier(0.01);
+    env.decayMultiplier = envelopeMultiplier(0.5);
+    env.sustainLevel = 0.5f;
+    env.releaseMultiplier = envelopeMultiplier(0.3);
+    env.attack();
+}
+
+// Calls the function on n inputs spread over [low, high].
+template<typename Function>
+static std::function<void()> mathBatch(int n, float low, float high, Function function)
+{
+    return [=]
+    {
+        float step = (high - low) / static_cast<float>(n);
+        float x = low;
+        float sum = 0.0f;
+        for (int i = 0; i < n; ++i)
+        {
+            sum += function(x);
+            x += step;
+        }
+        sink = sum;
+    };
+}
+
+static void benchmarkComponents(const Options& options, std::vector<Measurement>& results)
+{
+    constexpr int N = 4096;
+    auto add = [&](const juce::String& name, const std::function<void()>& batch)
+    {
+        if (name.contains(options.filter))
+        {
+            results.push_back(measure(name, options.seconds, N, batch));
+        }
+    };
+
+    Wavetable wavetable;
+    wavetable.build();
+    const Wavetable* tables[] = { nullptr, &wavetable };
+
+    for (float period : { 8.0f, 50.0f, 200.0f, 1000.0f })
+    {
+        juce::String suffix = "/period " + juce::String(static_cast<int>(period));
+        for (const Wavetable* table : tables)
+        {
+            auto osc = std::make_shared<Oscillator>();
+            osc->reset();
+            osc->wavetable = table;
+            osc->period = period;
+            osc->amplitude = 0.5f;
+            add(juce::String(table == nullptr ? "oscillator blit" : "oscillator wavetable") + suffix, [osc]
+            {
+                float sum = 0.0f;
+                for (int i = 0; i < N; ++i) { sum += osc->nextSample(); }
+                sink = sum;
+            });
+        }
+    }
+
+    // The FastMath kernels next to the libm calls they replace, over the ranges the DSP path
+    // uses them for.
+    constexpr float PI = 3.14159265f;
+    add("fastmath sin", mathBatch(N, -8.0f * PI, 8.0f * PI, [](float x) { return FastMath::sin(x); }));
+    add("std::sin", mathBatch(N, -8.0f * PI, 8.0f * PI, [](float x) { return std::sin(x); }));
+    add("fastmath cos", mathBatch(N, -8.0f * PI, 8.0f * PI, [](float x) { return FastMath::cos(x); }));
+    add("std::cos", mathBatch(N, -8.0f * PI, 8.0f * PI, [](float x) { return std::cos(x); }));
+    add("fastmath tan", mathBatch(N, -1.45f, 1.45f, [](float x) { return FastMath::tan(x); }));
+    add("std::tan", mathBatch(N, -1.45f, 1.45f, [](float x) { return std::tan(x); }));
+    add("fastmath exp", mathBatch(N, -20.0f, 20.0f, [](float x) { return FastMath::exp(x); }));
+    add("std::exp", mathBatch(N, -20.0f, 20.0f, [](float x) { return std::exp(x); }));
+
+    auto filter = std::make_shared<Filter>();
+    filter->reset();
+    filter->sampleRate = static_cast<float>(SAMPLE_RATE);
+    filter->updateCoefficients(2000.0f, 2.0f);
+    add("filter render", [filter]
+    {
+        float x = 0.0f;
+        for (int i = 0; i < N; ++i) { x = filter->render(x + 0.001f); }
+        sink = x;
+    });
+    // The cutoff follows the output, or the compiler would only keep the last update.
+    // Less "filter render" is the cost of the update.
+    add("filter updateCoefficients+render", [filter]
+    {
+        float x = 0.0f;
+        for (int i = 0; i < N; ++i)
+        {
+            filter->updateCoefficients(2000.0f + 100.0f * x, 2.0f);
+            x = filter->render(0.001f);
+        }
+        sink = x;
+    });
+
+    auto env = std::make_shared<Envelope>();
+    add("envelope nextValue", [env]
+    {
+        setUpEnvelope(*env);
+        float sum = 0.0f;
+        for (int i = 0; i < N; ++i) { sum += env->nextValue(); }
+        sink = sum;
+    });
+    add("envelope renderBlock", [env]
+    {
+        float values[N];
+        setUpEnvelope(*env);
+        sink = static_cast<float>(env->renderBlock(values, N)) + values[N - 1];
+    });
+
+    auto noise = std::make_shared<NoiseGenerator>();
+    noise->reset();
+    add("noise nextValue", [noise]
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < N; ++i) { sum += noise->nextValue(); }
+        sink = sum;
+    });
+
+    // A voice with each oscillator engine, struck again every batch so the envelope never
+    // runs out.
+    for (const Wavetable* table : tables)
+    {
+        juce::String engine = table == nullptr ? "blit" : "wavetable";
+        auto voice = std::make_shared<Voice>();
+        auto strike = [voice, table]
+        {
+            voice->reset();
+            voice->osc1.wavetable = table;
+            voice->osc1.period = 100.0f;
+            voice->osc1.amplitude = 0.5f;
+            voice->osc2.wavetable = table;
+            voice->osc2.period = 100.5f;
+            voice->osc2.amplitude = 0.5f;
+            voice->filter.sampleRate = static_cast<float>(SAMPLE_RATE);
+            voice->filter.updateCoefficients(2000.0f, 2.0f);
+            setUpEnvelope(voice->env);
+        };
+        add("voice " + engine + " render", [voice, strike]
+        {
+            strike();
+            float sum = 0.0f;
+            for (int i = 0; i < N; ++i) { sum += voice->render(0.0f); }
+            sink = sum;
+        });
+        add("voice " + engine + " renderBlock", [voice, strike]
+        {
+            static float input[N];
+            float output[N];
+            strike();
+            sink = static_cast<float>(voice->renderBlock(input, output, N)) + output[N - 1];
+        });
+    }
+
+    // A voice whose filter envelope sweeps the cutoff, with the coefficients set once per
+    // control tick like the synth does, either stepping there (control rate) or ramping
+    // sample by sample with Filter::renderRamped (audio rate).
+    auto filterTable = std::make_shared<FilterTable>();
+    filterTable->build(static_cast<float>(SAMPLE_RATE));
+    for (float filterRamp : { 0.0f, 1.0f / Synth::LFO_MAX })
+    {
+        juce::String rate = filterRamp == 0.0f ? "control" : "audio";
+        auto voice = std::make_shared<Voice>();
+        auto strike = [voice]
+        {
+            voice->reset();
+            voice->osc1.period = 100.0f;
+            voice->osc1.amplitude = 0.5f;
+            voice->osc2.period = 100.5f;
+            voice->osc2.amplitude = 0.5f;
+            voice->period = voice->target = 100.0f;
+            voice->glideRate = 0.0f;
+            voice->logCutoff = std::log(300.0f);
+            voice->filterMod = 0.0f;
+            voice->filterDamping = 0.5f;
+            voice->filterEnvDepth = 3.0f;
+            setUpEnvelope(voice->env);
+            setUpEnvelope(voice->filterEnv);
+        };
+        add("voice filter " + rate + " rate render", [voice, strike, filterTable, filterRamp]
+        {
+            strike();
+            float sum = 0.0f;
+            for (int i = 0; i < N; i += Synth::LFO_MAX)
+            {
+                voice->updateLFO(*filterTable, filterRamp);
+                for (int j = 0; j < Synth::LFO_MAX; ++j) { sum += voice->render(0.0f); }
+            }
+            sink = sum;
+        });
+        add("voice filter " + rate + " rate renderBlock", [voice, strike, filterTable, filterRamp]
+        {
+            static float input[N];
+            float output[N];
+            strike();
+            for (int i = 0; i < N; i += Synth::LFO_MAX)
+            {
+                voice->updateLFO(*filterTable, filterRamp);
+                voice->renderBlock(input + i, output + i, Synth::LFO_MAX);
+            }
+            sink = output[N - 1];
+        });
+    }
+}
+
+// processBlock on a processor playing 1 to 8 notes with each factory preset. The notes are
+// struck again every quarter of a second, so presets that die away keep sounding. The presets
+// play with the filter at control rate, and again at audio rate for 1 and 8 notes.
+static void benchmarkSynth(const Options& options, std::vector<Measurement>& results)
+{
+    constexpr int BLOCKS = static_cast<int>(SAMPLE_RATE / 4) / BLOCK_SIZE;
+
+    JX11AudioProcessor processor;
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, SAMPLE_RATE, BLOCK_SIZE);
+    auto* filterRate = processor.apvts.getParameter(ParameterID::filterRate.getParamID());
+
+    juce::AudioBuffer<float> buffer(2, BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+
+    for (int program = 0; program < processor.getNumPrograms(); ++program)
+    {
+        for (int audioRate = 0; audioRate <= 1; ++audioRate)
+        {
+            for (int notes = 1; notes <= 8; ++notes)
+            {
+                if (audioRate == 1 && notes != 1 && notes != 8) { continue; }
+
+                juce::String name = juce::String(audioRate == 1 ? "synth audio-rate filter/" : "synth/")
+                                  + processor.getProgramName(program) + "/" + juce::String(notes) + (notes == 1 ? " note" : " notes");
+                if (!name.contains(options.filter)) { continue; }
+
+                processor.setCurrentProgram(program);
+                filterRate->setValueNotifyingHost(filterRate->convertTo0to1(static_cast<float>(audioRate)));
+                processor.prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+
+                results.push_back(measure(name, options.seconds, BLOCKS * BLOCK_SIZE, [&]
+                {
+                    midiMessages.clear();
+                    for (int n = 0; n < notes; ++n)
+                    {
+                        midiMessages.addEvent(juce::MidiMessage::noteOff(1, 48 + 5 * n), 0);
+                        midiMessages.addEvent(juce::MidiMessage::noteOn(1, 48 + 5 * n, static_cast<juce::uint8>(100)), 0);
+                    }
+                    for (int block = 0; block < BLOCKS; ++block)
+                    {
+                        processor.processBlock(buffer, midiMessages);
+                        midiMessages.clear();
+                    }
+                    sink = buffer.getReadPointer(0)[0];
+                }));
+
+                processor.releaseResources();
+            }
+        }
+    }
+}
+
+// The cost of the parameter updates under dense automation: processBlock on short blocks with
+// no notes, with no parameter moving, with one moving every block, and with all of them moving
+// every block, which is what the processor recomputed on any change before it tracked the
+// changed slots. The differences to the first are the cost of passing the changes on and
+// updating what depends on them.
+static void benchmarkUpdates(const Options& options, std::vector<Measurement>& results)
+{
+    constexpr int UPDATE_BLOCK_SIZE = 64;
+    constexpr int BLOCKS = 64;
+
+    JX11AudioProcessor processor;
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, SAMPLE_RATE, UPDATE_BLOCK_SIZE);
+    processor.prepareToPlay(SAMPLE_RATE, UPDATE_BLOCK_SIZE);
+
+    juce::AudioBuffer<float> buffer(2, UPDATE_BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+
+    std::vector<juce::AudioProcessorParameter*> all(processor.getParameters().begin(), processor.getParameters().end());
+    std::vector<juce::AudioProcessorParameter*> one = { processor.apvts.getParameter(ParameterID::filterFreq.getParamID()) };
+    std::vector<juce::AudioProcessorParameter*> none;
+
+    // Each change moves the parameter by a hair and back, so the sound stays the same.
+    auto automate = [&](const std::vector<juce::AudioProcessorParameter*>& moving)
+    {
+        return [&processor, &buffer, &midiMessages, moving]
+        {
+            for (int block = 0; block < BLOCKS; ++block)
+            {
+                for (auto* parameter : moving)
+                {
+                    float value = parameter->getValue();
+                    parameter->setValueNotifyingHost(block % 2 == 0 ? std::min(value + 1e-4f, 1.0f) : std::max(value - 1e-4f, 0.0f));
+                }
+                processor.processBlock(buffer, midiMessages);
+            }
+            sink = buffer.getReadPointer(0)[0];
+        };
+    };
+
+    auto add = [&](const juce::String& name, const std::vector<juce::AudioProcessorParameter*>& moving)
+    {
+        if (name.contains(options.filter))
+        {
+            results.push_back(measure(name, options.seconds, BLOCKS * UPDATE_BLOCK_SIZE, automate(moving)));
+        }
+    };
+    add("parameter updates/none", none);
+    add("parameter updates/1 slot per block", one);
+    add("parameter updates/all " + juce::String(static_cast<int>(all.size())) + " slots per block", all);
+
+    processor.releaseResources();
+}
+
+static std::map<juce::String, double> readResults(const juce::File& file)
+{
+    std::map<juce::String, double> results;
+    auto lines = juce::StringArray::fromLines(file.loadFileAsString());
+    for (const auto& line : lines)
+    {
+        // The name may have commas in it, the numbers do not.
+        int second = line.lastIndexOfChar(',');
+        int first = line.substring(0, second).lastIndexOfChar(',');
+        if (first > 0)
+        {
+            results[line.substring(0, first)] = line.substring(first + 1, second).getDoubleValue();
+        }
+    }
+    return results;
+}
+
+static bool parseOptions(const juce::StringArray& args, Options& options)
+{
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 0; i + 1 < args.size(); i += 2)
+    {
+        const juce::String& arg = args[i];
+        const juce::String& value = args[i + 1];
+
+        if (arg == "--filter") { options.filter = value; }
+        else if (arg == "--time") { options.seconds = value.getDoubleValue(); }
+        else if (arg == "--csv") { options.csv = cwd.getChildFile(value); }
+        else if (arg == "--compare") { options.baseline = cwd.getChildFile(value); }
+        else if (arg == "--threshold") { options.threshold = value.getDoubleValue(); }
+        else { return false; }
+    }
+    return args.size() % 2 == 0 && options.seconds > 0.0;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    Options options;
+    if (!parseOptions(juce::StringArray(argv + 1, argc - 1), options))
+    {
+        std::cerr << "Usage: JX11Benchmarks [--filter text] [--time seconds] [--csv file] [--compare file] [--threshold percent]" << std::endl;
+        return 1;
+    }
+
+    std::map<juce::String, double> baseline;
+    if (options.baseline != juce::File())
+    {
+        baseline = readResults(options.baseline);
+        if (baseline.empty())
+        {
+            std::cerr << "No results in " << options.baseline.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Measurement> results;
+    benchmarkComponents(options, results);
+    benchmarkSynth(options, results);
+    benchmarkUpdates(options, results);
+    if (results.empty())
+    {
+        std::cerr << "No benchmark matches \"" << options.filter << "\"" << std::endl;
+        return 1;
+    }
+
+    juce::String csv;
+    int regressions = 0;
+    int broken = 0;
+    for (const auto& result : results)
+    {
+        std::cout << result.name << "\t" << juce::String(result.nsPerSample, 2) << " ns/sample\t"
+                  << juce::String(result.realTimeFactor, 1) << "x real time";
+
+        // A time that is not a positive number means the benchmark did no work.
+        if (!(result.nsPerSample > 0.0 && std::isfinite(result.nsPerSample)))
+        {
+            std::cout << "\tBROKEN";
+            ++broken;
+        }
+
+        auto before = baseline.find(result.name);
+        if (before != baseline.end())
+        {
+            double change = 100.0 * (result.nsPerSample / before->second - 1.0);
+            std::cout << "\t" << (change >= 0.0 ? "+" : "") << juce::String(change, 1) << "%";
+            if (change > options.threshold)
+            {
+                std::cout << " SLOWER";
+                ++regressions;
+            }
+        }
+        std::cout << "\n";
+
+        csv += result.name + "," + juce::String(result.nsPerSample, 4) + "," + juce::String(result.realTimeFactor, 2) + "\n";
+    }
+
+    if (options.csv != juce::File() && !options.csv.replaceWithText(csv))
+    {
+        std::cerr << "Cannot write " << options.csv.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    if (broken > 0)
+    {
+        std::cout << broken << " benchmarks measured no time" << std::endl;
+        return 1;
+    }
+    if (regressions > 0)
+    {
+        std::cout << regressions << " benchmarks slower than the baseline by more than " << options.threshold << "%" << std::endl;
+        return 1;
+    }
+    return 0;
+}
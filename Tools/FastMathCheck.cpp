@@ -0,0 +1,110 @@
+// Checks the FastMath kernels against double precision libm over the ranges FastMath.h gives
+// error bounds for, and that the SimdFloat versions compute exactly what the float versions
+// compute.
+//
+//     JX11FastMathCheck
+//
+// Every range is scanned at POINTS evenly spaced inputs and as many random ones. Prints the
+// largest error of each kernel and exits with 1 if one is over its bound.
+
+#include <JuceHeader.h>
+#include "FastMath.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+static constexpr int POINTS = 1 << 20;
+
+struct Kernel
+{
+    const char* name;
+    float low, high;
+    double bound;
+    bool relative;
+    std::function<float(float)> fast;
+    std::function<SimdFloat(SimdFloat)> fastSimd;
+    std::function<double(double)> exact;
+};
+
+static const Kernel kernels[] =
+{
+    { "sin", -8.0f * 3.14159265f, 8.0f * 3.14159265f, 2e-7, false,
+      [](float x) { return FastMath::sin(x); }, [](SimdFloat x) { return FastMath::sin(x); },
+      [](double x) { return std::sin(x); } },
+    { "cos", -8.0f * 3.14159265f, 8.0f * 3.14159265f, 2e-7, false,
+      [](float x) { return FastMath::cos(x); }, [](SimdFloat x) { return FastMath::cos(x); },
+      [](double x) { return std::cos(x); } },
+    { "tan", -1.45f, 1.45f, 1.2e-6, true,
+      [](float x) { return FastMath::tan(x); }, [](SimdFloat x) { return FastMath::tan(x); },
+      [](double x) { return std::tan(x); } },
+    { "exp", -87.0f, 88.0f, 1.2e-7, true,
+      [](float x) { return FastMath::exp(x); }, [](SimdFloat x) { return FastMath::exp(x); },
+      [](double x) { return std::exp(x); } },
+};
+
+struct Scan
+{
+    double worst = 0.0;
+    float worstInput = 0.0f;
+    int laneMismatches = 0;
+};
+
+// Eight inputs at a time, so the SimdFloat version sees the same inputs in its lanes.
+static void check(const Kernel& kernel, const float* inputs, Scan& scan)
+{
+    alignas(SimdFloat::alignment) float lanes[SimdFloat::size];
+    std::memcpy(lanes, inputs, sizeof(lanes));
+    kernel.fastSimd(SimdFloat::load(lanes)).store(lanes);
+
+    for (int i = 0; i < SimdFloat::size; ++i)
+    {
+        float x = inputs[i];
+        float fast = kernel.fast(x);
+        if (std::memcmp(&fast, &lanes[i], sizeof(fast)) != 0) { ++scan.laneMismatches; }
+
+        double exact = kernel.exact(static_cast<double>(x));
+        double error = std::abs(static_cast<double>(fast) - exact);
+        if (kernel.relative) { error /= std::abs(exact); }
+        if (!(error <= scan.worst))  // NaN counts as the worst
+        {
+            scan.worst = error;
+            scan.worstInput = x;
+        }
+    }
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    juce::Random random(11);
+    int failures = 0;
+    for (const Kernel& kernel : kernels)
+    {
+        Scan scan;
+        float inputs[SimdFloat::size];
+        for (int i = 0; i < POINTS; i += SimdFloat::size)
+        {
+            for (int lane = 0; lane < SimdFloat::size; ++lane)
+            {
+                float t = static_cast<float>(i + lane) / static_cast<float>(POINTS - 1);
+                inputs[lane] = kernel.low + t * (kernel.high - kernel.low);
+            }
+            check(kernel, inputs, scan);
+
+            for (float& input : inputs)
+            {
+                input = kernel.low + random.nextFloat() * (kernel.high - kernel.low);
+            }
+            check(kernel, inputs, scan);
+        }
+
+        bool passed = scan.worst <= kernel.bound && scan.laneMismatches == 0;
+        std::cout << (passed ? "ok   " : "FAIL ") << kernel.name << " on [" << kernel.low << ", " << kernel.high << "]: "
+                  << (kernel.relative ? "relative" : "absolute") << " error " << scan.worst << " at " << scan.worstInput
+                  << ", bound " << kernel.bound << ", SimdFloat lanes differing " << scan.laneMismatches << "\n";
+        if (!passed) { ++failures; }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,445 @@
+// Renders fixed MIDI scripts through every factory preset and compares the audio with
+// reference renders recorded earlier, so that a rewrite of the engine can be shown not to
+// change the sound. The renders run in parallel, one processor each.
+//
+//     JX11Golden record <dir> [options]   writes the reference renders
+//     JX11Golden check <dir> [options]    renders again and compares
+//
+//     --filter <text>    only the tests whose name contains the text
+//     --jobs <n>         tests rendered at once, one per core by default
+//     --max-abs <x>      check every test against this largest sample difference instead
+//     --spectral <dB>    and this spectral distance, see below
+//
+// Each script has its own tolerance. Most have to match to the bit. The ones that move the
+// pitch by the sample are let off with a small difference, because there any reordering of
+// the phase arithmetic gives slightly different samples without a difference anyone could
+// hear. Those have to stay within both the largest difference of a sample and the spectral
+// distance: the RMS difference in dB between the spectra of the worst frame, per channel.
+//
+// The references are 32 bit float WAV files, so they keep every bit of the output.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr double SECONDS = 4.0;
+
+// Blocks of changing sizes, so events land everywhere within a block.
+static constexpr int BLOCK_SIZES[] = { 512, 100, 256, 37, 480 };
+static constexpr int MAX_BLOCK_SIZE = 512;
+
+struct Tolerance
+{
+    double maxAbs = 0.0;      // both 0 means bit-exact
+    double spectralDb = 0.0;
+
+    bool isBitExact() const { return maxAbs == 0.0 && spectralDb == 0.0; }
+};
+
+struct Script
+{
+    const char* name;
+    Tolerance tolerance;
+    std::function<void(JX11AudioProcessor&)> setUp;
+    std::function<void(juce::MidiMessageSequence&)> write;
+};
+
+static void add(juce::MidiMessageSequence& sequence, double time, juce::MidiMessage message)
+{
+    message.setTimeStamp(time);
+    sequence.addEvent(message);
+}
+
+static void note(juce::MidiMessageSequence& sequence, double on, double off, int number, int velocity)
+{
+    add(sequence, on, juce::MidiMessage::noteOn(1, number, static_cast<juce::uint8>(velocity)));
+    add(sequence, off, juce::MidiMessage::noteOff(1, number));
+}
+
+static void setParameter(JX11AudioProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter = processor.apvts.getParameter(id.getParamID());
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+static std::vector<Script> createScripts()
+{
+    std::vector<Script> scripts;
+
+    scripts.push_back({ "notes", {}, nullptr, [](juce::MidiMessageSequence& s)
+    {
+        // A chord built up and let go one note at a time, a repeated note, and a run.
+        int chord[] = { 48, 55, 64, 71 };
+        for (int i = 0; i < 4; ++i)
+        {
+            note(s, 0.1 * i, 1.2 + 0.1 * i, chord[i], 40 + 25 * i);
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            note(s, 1.8 + 0.15 * i, 1.9 + 0.15 * i, 60, 127 - 20 * i);
+        }
+        for (int i = 0; i < 12; ++i)
+        {
+            note(s, 2.5 + 0.07 * i, 2.6 + 0.07 * i, 50 + 3 * i, 90);
+        }
+    } });
+
+    scripts.push_back({ "sustain", {}, nullptr, [](juce::MidiMessageSequence& s)
+    {
+        // Notes released under the pedal, struck again under it, then the pedal lifted.
+        note(s, 0.0, 0.4, 52, 100);
+        add(s, 0.2, juce::MidiMessage::controllerEvent(1, 0x40, 127));
+        note(s, 0.5, 0.7, 59, 100);
+        note(s, 0.9, 1.0, 52, 70);
+        note(s, 1.2, 2.6, 64, 100);
+        add(s, 2.0, juce::MidiMessage::controllerEvent(1, 0x40, 0));
+        note(s, 2.8, 3.0, 67, 100);
+    } });
+
+    scripts.push_back({ "bend", { 1e-3, 0.5 }, nullptr, [](juce::MidiMessageSequence& s)
+    {
+        // A held chord with the wheel swept all the way up, all the way down and back.
+        note(s, 0.0, 3.0, 57, 100);
+        note(s, 0.0, 3.0, 64, 100);
+        for (int i = 0; i <= 250; ++i)
+        {
+            double phase = i / 250.0;
+            int value = 8192 + static_cast<int>(std::lround(8191.0 * std::sin(6.283185307179586 * phase)));
+            add(s, 0.25 + 2.5 * phase, juce::MidiMessage::pitchWheel(1, value));
+        }
+    } });
+
+    scripts.push_back({ "modwheel", { 1e-3, 0.5 }, nullptr, [](juce::MidiMessageSequence& s)
+    {
+        // A held note with the mod wheel brought up and down again.
+        note(s, 0.0, 3.0, 60, 100);
+        for (int i = 0; i <= 127; ++i)
+        {
+            add(s, 0.2 + 0.01 * i, juce::MidiMessage::controllerEvent(1, 0x01, i));
+            add(s, 2.8 - 0.01 * i, juce::MidiMessage::controllerEvent(1, 0x01, i));
+        }
+    } });
+
+    scripts.push_back({ "legato", { 1e-3, 0.5 },
+        [](JX11AudioProcessor& processor)
+        {
+            setParameter(processor, ParameterID::polyMode, 1.0f);
+            setParameter(processor, ParameterID::glideMode, 1.0f);  // Legato
+            setParameter(processor, ParameterID::glideRate, 50.0f);
+        },
+        [](juce::MidiMessageSequence& s)
+        {
+            // Overlapping notes glide, the detached ones in between do not, and letting
+            // go of the top note falls back to the one still held.
+            note(s, 0.0, 0.6, 48, 100);
+            note(s, 0.5, 1.1, 55, 100);
+            note(s, 1.0, 1.4, 60, 100);
+            note(s, 1.6, 1.8, 67, 100);
+            note(s, 2.0, 3.0, 48, 100);
+            note(s, 2.3, 2.6, 60, 100);
+        } });
+
+    return scripts;
+}
+
+struct Test
+{
+    int program;
+    const Script* script;
+    juce::String name;
+    juce::File reference;
+};
+
+struct Result
+{
+    juce::String error;
+    double maxAbs = 0.0;
+    double spectralDb = 0.0;
+};
+
+static juce::AudioBuffer<float> render(int program, const Script& script)
+{
+    JX11AudioProcessor processor;
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, SAMPLE_RATE, MAX_BLOCK_SIZE);
+    processor.setCurrentProgram(program);
+    if (script.setUp) { script.setUp(processor); }
+    processor.prepareToPlay(SAMPLE_RATE, MAX_BLOCK_SIZE);
+
+    juce::MidiMessageSequence sequence;
+    script.write(sequence);
+    sequence.sort();
+
+    int totalSamples = static_cast<int>(SECONDS * SAMPLE_RATE);
+    juce::AudioBuffer<float> output(2, totalSamples);
+    juce::AudioBuffer<float> buffer(2, MAX_BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+
+    int nextEvent = 0;
+    for (int position = 0, block = 0; position < totalSamples; position += buffer.getNumSamples(), ++block)
+    {
+        int sampleCount = std::min(BLOCK_SIZES[static_cast<size_t>(block) % std::size(BLOCK_SIZES)], totalSamples - position);
+        buffer.setSize(2, sampleCount, false, false, true);
+
+        midiMessages.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+        {
+            const auto& message = sequence.getEventPointer(nextEvent)->message;
+            int sample = static_cast<int>(std::lround(message.getTimeStamp() * SAMPLE_RATE));
+            if (sample >= position + sampleCount) { break; }
+            midiMessages.addEvent(message, std::max(sample - position, 0));
+        }
+
+        processor.processBlock(buffer, midiMessages);
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            output.copyFrom(channel, position, buffer, channel, 0, sampleCount);
+        }
+    }
+    return output;
+}
+
+// In-place radix-2 FFT, size a power of two.
+static void fft(std::vector<std::complex<double>>& x)
+{
+    size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; ++i)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) { j ^= bit; }
+        j ^= bit;
+        if (i < j) { std::swap(x[i], x[j]); }
+    }
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+        auto step = std::polar(1.0, -6.283185307179586 / static_cast<double>(length));
+        for (size_t i = 0; i < n; i += length)
+        {
+            std::complex<double> w = 1.0;
+            for (size_t k = 0; k < length / 2; ++k)
+            {
+                auto a = x[i + k];
+                auto b = x[i + k + length / 2] * w;
+                x[i + k] = a + b;
+                x[i + k + length / 2] = a - b;
+                w *= step;
+            }
+        }
+    }
+}
+
+// Magnitudes in dB of a Hann-windowed frame, with everything under -100 dB taken as -100 dB
+// so that differences in silence do not count.
+static std::vector<double> spectrum(const float* samples)
+{
+    constexpr size_t N = 2048;
+    std::vector<std::complex<double>> x(N);
+    for (size_t i = 0; i < N; ++i)
+    {
+        double window = 0.5 - 0.5 * std::cos(6.283185307179586 * static_cast<double>(i) / N);
+        x[i] = window * samples[i];
+    }
+    fft(x);
+
+    std::vector<double> db(N / 2);
+    for (size_t i = 0; i < N / 2; ++i)
+    {
+        double magnitude = std::abs(x[i]) / (N / 4);  // a full-scale sine reads 0 dB
+        db[i] = 20.0 * std::log10(std::max(magnitude, 1e-5));
+    }
+    return db;
+}
+
+static double spectralDistance(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+{
+    constexpr int N = 2048;
+    double worst = 0.0;
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        for (int start = 0; start + N <= a.getNumSamples(); start += N / 2)
+        {
+            auto x = spectrum(a.getReadPointer(channel, start));
+            auto y = spectrum(b.getReadPointer(channel, start));
+            double sum = 0.0;
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                sum += (x[i] - y[i]) * (x[i] - y[i]);
+            }
+            worst = std::max(worst, std::sqrt(sum / static_cast<double>(x.size())));
+        }
+    }
+    return worst;
+}
+
+static bool writeReference(const juce::File& file, const juce::AudioBuffer<float>& audio)
+{
+    file.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+    if (!stream->openedOk()) { return false; }
+
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), SAMPLE_RATE, 2, 32, {}, 0));
+    if (writer == nullptr) { return false; }
+    stream.release();  // the writer owns it now
+    return writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+}
+
+static bool readReference(const juce::File& file, juce::AudioBuffer<float>& audio)
+{
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(new juce::FileInputStream(file), true));
+    if (reader == nullptr || reader->numChannels != 2) { return false; }
+
+    audio.setSize(2, static_cast<int>(reader->lengthInSamples));
+    return reader->read(&audio, 0, audio.getNumSamples(), 0, true, true);
+}
+
+static Result check(const Test& test, const Tolerance& tolerance)
+{
+    Result result;
+    juce::AudioBuffer<float> expected;
+    if (!readReference(test.reference, expected))
+    {
+        result.error = "no reference " + test.reference.getFullPathName();
+        return result;
+    }
+
+    auto actual = render(test.program, *test.script);
+    if (actual.getNumSamples() != expected.getNumSamples())
+    {
+        result.error = "the reference has a different length";
+        return result;
+    }
+
+    // memcmp rather than comparing samples, so that NaNs in the same places match too.
+    bool identical = true;
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        const float* a = actual.getReadPointer(channel);
+        const float* e = expected.getReadPointer(channel);
+        identical = identical && std::memcmp(a, e, sizeof(float) * static_cast<size_t>(actual.getNumSamples())) == 0;
+        for (int i = 0; i < actual.getNumSamples(); ++i)
+        {
+            result.maxAbs = std::max(result.maxAbs, static_cast<double>(std::abs(a[i] - e[i])));
+        }
+    }
+
+    if (identical) { return result; }
+    if (tolerance.isBitExact())
+    {
+        result.error = "not bit-exact";
+        return result;
+    }
+
+    result.spectralDb = spectralDistance(actual, expected);
+    if (!(result.maxAbs <= tolerance.maxAbs) || !(result.spectralDb <= tolerance.spectralDb))
+    {
+        result.error = "out of tolerance";
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    juce::StringArray args(argv + 1, argc - 1);
+    juce::String command = args[0];
+    juce::File directory = juce::File::getCurrentWorkingDirectory().getChildFile(args[1]);
+
+    juce::String filter;
+    int jobs = juce::SystemStats::getNumCpus();
+    Tolerance tolerance;
+    bool valid = (command == "record" || command == "check") && args.size() >= 2 && args.size() % 2 == 0;
+    for (int i = 2; valid && i < args.size(); i += 2)
+    {
+        if (args[i] == "--filter") { filter = args[i + 1]; }
+        else if (args[i] == "--jobs") { jobs = args[i + 1].getIntValue(); }
+        else if (args[i] == "--max-abs") { tolerance.maxAbs = args[i + 1].getDoubleValue(); }
+        else if (args[i] == "--spectral") { tolerance.spectralDb = args[i + 1].getDoubleValue(); }
+        else { valid = false; }
+    }
+    if (!valid || jobs < 1)
+    {
+        std::cerr << "Usage: JX11Golden record|check <dir> [--filter text] [--jobs n] [--max-abs x] [--spectral dB]" << std::endl;
+        return 1;
+    }
+
+    auto scripts = createScripts();
+    std::vector<Test> tests;
+    {
+        JX11AudioProcessor processor;
+        for (int program = 0; program < processor.getNumPrograms(); ++program)
+        {
+            for (const Script& script : scripts)
+            {
+                juce::String name = juce::String(program).paddedLeft('0', 2) + " "
+                                  + processor.getProgramName(program) + " " + script.name;
+                if (!name.contains(filter)) { continue; }
+                juce::File reference = directory.getChildFile(juce::File::createLegalFileName(name) + ".wav");
+                tests.push_back({ program, &script, name, reference });
+            }
+        }
+    }
+
+    if (command == "record") { directory.createDirectory(); }
+
+    std::vector<Result> results(tests.size());
+    auto start = juce::Time::getHighResolutionTicks();
+    {
+        juce::ThreadPool pool(std::min(jobs, std::max(1, static_cast<int>(tests.size()))));
+        std::atomic<size_t> remaining { tests.size() };
+        for (size_t i = 0; i < tests.size(); ++i)
+        {
+            pool.addJob([&, i]
+            {
+                const Test& test = tests[i];
+                if (command == "record")
+                {
+                    if (!writeReference(test.reference, render(test.program, *test.script)))
+                    {
+                        results[i].error = "cannot write " + test.reference.getFullPathName();
+                    }
+                }
+                else
+                {
+                    bool overridden = tolerance.maxAbs > 0.0 || tolerance.spectralDb > 0.0;
+                    results[i] = check(test, overridden ? tolerance : test.script->tolerance);
+                }
+                --remaining;
+            });
+        }
+        while (remaining.load() > 0)
+        {
+            juce::Thread::sleep(10);
+        }
+    }
+    double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+    int failures = 0;
+    for (size_t i = 0; i < tests.size(); ++i)
+    {
+        const Result& result = results[i];
+        if (result.error.isEmpty()) { continue; }
+        ++failures;
+        std::cout << "FAIL " << tests[i].name << ": " << result.error;
+        if (command == "check" && result.maxAbs > 0.0)
+        {
+            std::cout << ", max abs " << result.maxAbs;
+            if (result.spectralDb > 0.0) { std::cout << ", spectral " << result.spectralDb << " dB"; }
+        }
+        std::cout << "\n";
+    }
+    std::cout << (command == "record" ? "recorded " : "passed ") << tests.size() - static_cast<size_t>(failures)
+              << " of " << tests.size() << " tests in " << seconds << " s" << std::endl;
+
+    return failures == 0 && !tests.empty() ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// Checks the ways of choosing a program against each other.
+//
+//     JX11ProgramCheck
+//
+// A Program Change on the first MIDI channel switches part 0 on the audio thread, and the
+// parameters follow when the message thread gets to it. For every factory preset, a processor
+// switched that way while notes play has to end up with the parameter values of one set to the
+// program with setCurrentProgram, and play the same audio exactly, before and after the
+// parameters catch up.
+//
+// A morph plays its first program at amount 0 and its second at 100. Morphing from each preset
+// to the one halfway along the bank and back, with the processor set to the preset that should
+// come out for what a morph leaves alone (polyphony and the fine tuning), has to play exactly
+// what the preset plays on its own.
+//
+// Prints each check that is off and exits with 1 if there is one.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <cmath>
+#include <iostream>
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr int BLOCK_SIZE = 256;
+static constexpr int BLOCKS = 300;
+
+// The block after which the message thread hears of the Program Change. Notes are sounding.
+static constexpr int NOTIFY_BLOCK = 15;
+
+static void setParameter(JX11AudioProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter = processor.apvts.getParameter(id.getParamID());
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+static void prepare(JX11AudioProcessor& processor)
+{
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, SAMPLE_RATE, BLOCK_SIZE);
+    processor.prepareToPlay(SAMPLE_RATE, BLOCK_SIZE);
+}
+
+// A note every 40 blocks, and a Program Change to the program at the start if there is one.
+// The console app has no message loop to run the timer, so it hands the program to the
+// parameters itself.
+static juce::AudioBuffer<float> render(JX11AudioProcessor& processor, int programChange)
+{
+    juce::AudioBuffer<float> output(2, BLOCK_SIZE * BLOCKS);
+    juce::AudioBuffer<float> buffer(2, BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+
+    for (int block = 0; block < BLOCKS; ++block)
+    {
+        midiMessages.clear();
+        if (block == 0 && programChange >= 0)
+        {
+            midiMessages.addEvent(juce::MidiMessage::programChange(1, programChange), 0);
+        }
+        if (block % 40 == 10)
+        {
+            midiMessages.addEvent(juce::MidiMessage::noteOn(1, 48 + block / 40, static_cast<juce::uint8>(100)), 17);
+        }
+        if (block % 40 == 35)
+        {
+            midiMessages.addEvent(juce::MidiMessage::noteOff(1, 48 + block / 40), 100);
+        }
+
+        buffer.clear();
+        processor.processBlock(buffer, midiMessages);
+        if (block == NOTIFY_BLOCK)
+        {
+            processor.notifyProgramChange();
+        }
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            output.copyFrom(channel, block * BLOCK_SIZE, buffer, channel, 0, BLOCK_SIZE);
+        }
+    }
+    return output;
+}
+
+static float maxDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+{
+    float largest = 0.0f;
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        const float* x = a.getReadPointer(channel);
+        const float* y = b.getReadPointer(channel);
+        for (int i = 0; i < a.getNumSamples(); ++i)
+        {
+            float difference = std::abs(x[i] - y[i]);
+            if (!(difference <= largest)) { largest = difference; }  // NaN counts as off
+        }
+    }
+    return largest;
+}
+
+static int countDifferentParameters(JX11AudioProcessor& a, JX11AudioProcessor& b)
+{
+    const auto& parametersA = a.getParameters();
+    const auto& parametersB = b.getParameters();
+    int count = 0;
+    for (int i = 0; i < parametersA.size(); ++i)
+    {
+        if (parametersA[i]->getValue() != parametersB[i]->getValue()) { ++count; }
+    }
+    return count;
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    JX11AudioProcessor names;
+    int checks = 0;
+    int failures = 0;
+    for (int program = 0; program < names.getNumPrograms(); ++program)
+    {
+        juce::String name = names.getProgramName(program);
+
+        JX11AudioProcessor switched;
+        prepare(switched);
+        auto switchedOutput = render(switched, program);
+
+        JX11AudioProcessor set;
+        set.setCurrentProgram(program);
+        prepare(set);
+        auto setOutput = render(set, -1);
+
+        ++checks;
+        int parameters = countDifferentParameters(switched, set);
+        if (switched.getCurrentProgram() != program || parameters != 0)
+        {
+            std::cout << "FAIL " << name << "/parameters: program " << switched.getCurrentProgram()
+                      << ", " << parameters << " parameters differ\n";
+            ++failures;
+        }
+
+        ++checks;
+        float difference = maxDifference(switchedOutput, setOutput);
+        if (difference != 0.0f)
+        {
+            std::cout << "FAIL " << name << "/audio: largest difference " << difference << "\n";
+            ++failures;
+        }
+
+        int other = (program + names.getNumPrograms() / 2) % names.getNumPrograms();
+        for (float amount : { 0.0f, 100.0f })
+        {
+            JX11AudioProcessor morphed;
+            morphed.setCurrentProgram(program);
+            if (amount == 0.0f) { morphed.setMorphPrograms(program, other); }
+            else { morphed.setMorphPrograms(other, program); }
+            setParameter(morphed, ParameterID::morph, amount);
+            prepare(morphed);
+
+            ++checks;
+            difference = maxDifference(render(morphed, -1), setOutput);
+            if (difference != 0.0f)
+            {
+                std::cout << "FAIL " << name << "/morph " << amount << ": largest difference " << difference << "\n";
+                ++failures;
+            }
+        }
+    }
+
+    std::cout << "passed " << checks - failures << " of " << checks << " checks" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+// Renders Standard MIDI Files to audio without a host, through the same processBlock path the
+// plugin takes. Files are rendered in parallel, one processor each.
+//
+//     JX11Render [options] <MIDI files...>
+//
+//     --out <dir>        where the audio goes, next to each MIDI file if not given
+//     --format wav|flac  24 bit WAV by default
+//     --rate <Hz>        48000 by default
+//     --block <samples>  512 by default
+//     --tail <seconds>   rendered after the last event, 2 by default
+//     --bank <file>      preset bank to take the programs from
+//     --program <n>      the program to play, 0 by default
+//     --state <file>     a saved plugin state to start from, instead of a program
+//     --jobs <n>         files rendered at once, one per core by default
+//
+// Prints the real-time factor of each file, audio seconds per second spent rendering it,
+// and of the whole batch.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+struct Options
+{
+    juce::File outputDirectory;
+    juce::String format = "wav";
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    double tailSeconds = 2.0;
+    juce::File bank;
+    int program = 0;
+    juce::File state;
+    int jobs = juce::SystemStats::getNumCpus();
+    juce::Array<juce::File> midiFiles;
+};
+
+struct Result
+{
+    juce::String error;
+    double audioSeconds = 0.0;
+    double renderSeconds = 0.0;
+};
+
+static std::unique_ptr<juce::AudioFormat> createFormat(const juce::String& name)
+{
+    if (name == "wav") { return std::make_unique<juce::WavAudioFormat>(); }
+    if (name == "flac") { return std::make_unique<juce::FlacAudioFormat>(); }
+    return nullptr;
+}
+
+// All tracks of the file in one sequence, timed in seconds.
+static bool readMidiFile(const juce::File& file, juce::MidiMessageSequence& sequence)
+{
+    juce::FileInputStream input(file);
+    juce::MidiFile midi;
+    if (!input.openedOk() || !midi.readFrom(input)) { return false; }
+
+    midi.convertTimestampTicksToSeconds();
+    for (int t = 0; t < midi.getNumTracks(); ++t)
+    {
+        sequence.addSequence(*midi.getTrack(t), 0.0);
+    }
+    sequence.sort();
+    return true;
+}
+
+static Result renderFile(const Options& options, const juce::File& midiFile)
+{
+    Result result;
+
+    juce::MidiMessageSequence sequence;
+    if (!readMidiFile(midiFile, sequence))
+    {
+        result.error = "cannot read " + midiFile.getFullPathName();
+        return result;
+    }
+
+    auto format = createFormat(options.format);
+    juce::File directory = options.outputDirectory == juce::File() ? midiFile.getParentDirectory() : options.outputDirectory;
+    juce::File audioFile = directory.getChildFile(midiFile.getFileNameWithoutExtension())
+                                    .withFileExtension(format->getFileExtensions()[0]);
+    audioFile.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(audioFile);
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    if (stream->openedOk())
+    {
+        writer.reset(format->createWriterFor(stream.get(), options.sampleRate, 2, 24, {}, 0));
+    }
+    if (writer == nullptr)
+    {
+        result.error = "cannot write " + audioFile.getFullPathName();
+        return result;
+    }
+    stream.release();  // the writer owns it now
+
+    JX11AudioProcessor processor;
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, options.sampleRate, options.blockSize);
+    if (options.bank != juce::File()) { processor.loadPresetBank(options.bank); }
+    if (options.state != juce::File())
+    {
+        juce::MemoryBlock state;
+        options.state.loadFileAsData(state);
+        processor.setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+    }
+    else
+    {
+        processor.setCurrentProgram(juce::jlimit(0, processor.getNumPrograms() - 1, options.program));
+    }
+    processor.prepareToPlay(options.sampleRate, options.blockSize);
+
+    double endTime = sequence.getEndTime() + options.tailSeconds;
+    auto totalSamples = static_cast<juce::int64>(std::ceil(endTime * options.sampleRate));
+
+    juce::AudioBuffer<float> buffer(2, options.blockSize);
+    juce::MidiBuffer midiMessages;
+    int nextEvent = 0;
+
+    auto start = juce::Time::getHighResolutionTicks();
+    for (juce::int64 position = 0; position < totalSamples; position += options.blockSize)
+    {
+        int sampleCount = static_cast<int>(std::min<juce::int64>(options.blockSize, totalSamples - position));
+        buffer.setSize(2, sampleCount, false, false, true);
+
+        midiMessages.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+        {
+            const auto& message = sequence.getEventPointer(nextEvent)->message;
+            auto sample = static_cast<juce::int64>(std::llround(message.getTimeStamp() * options.sampleRate));
+            if (sample >= position + sampleCount) { break; }
+            if (message.isMetaEvent()) { continue; }
+            midiMessages.addEvent(message, static_cast<int>(std::max<juce::int64>(sample - position, 0)));
+        }
+
+        processor.processBlock(buffer, midiMessages);
+        writer->writeFromAudioSampleBuffer(buffer, 0, sampleCount);
+    }
+    result.renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    result.audioSeconds = static_cast<double>(totalSamples) / options.sampleRate;
+
+    processor.releaseResources();
+    return result;
+}
+
+static bool parseOptions(const juce::StringArray& args, Options& options)
+{
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const juce::String& arg = args[i];
+        if (arg.startsWith("--"))
+        {
+            if (i + 1 == args.size()) { return false; }
+            const juce::String& value = args[++i];
+
+            if (arg == "--out") { options.outputDirectory = cwd.getChildFile(value); }
+            else if (arg == "--format") { options.format = value.toLowerCase(); }
+            else if (arg == "--rate") { options.sampleRate = value.getDoubleValue(); }
+            else if (arg == "--block") { options.blockSize = value.getIntValue(); }
+            else if (arg == "--tail") { options.tailSeconds = value.getDoubleValue(); }
+            else if (arg == "--bank") { options.bank = cwd.getChildFile(value); }
+            else if (arg == "--program") { options.program = value.getIntValue(); }
+            else if (arg == "--state") { options.state = cwd.getChildFile(value); }
+            else if (arg == "--jobs") { options.jobs = value.getIntValue(); }
+            else { return false; }
+        }
+        else
+        {
+            options.midiFiles.add(cwd.getChildFile(arg));
+        }
+    }
+
+    return !options.midiFiles.isEmpty()
+        && createFormat(options.format) != nullptr
+        && options.sampleRate > 0.0
+        && options.blockSize > 0
+        && options.tailSeconds >= 0.0
+        && options.jobs > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    Options options;
+    if (!parseOptions(juce::StringArray(argv + 1, argc - 1), options))
+    {
+        std::cerr << "Usage: JX11Render [--out dir] [--format wav|flac] [--rate Hz] [--block samples] [--tail seconds]\n"
+                     "                  [--bank file] [--program n | --state file] [--jobs n] <MIDI files...>" << std::endl;
+        return 1;
+    }
+    if (options.outputDirectory != juce::File()) { options.outputDirectory.createDirectory(); }
+
+    std::vector<Result> results(static_cast<size_t>(options.midiFiles.size()));
+    std::atomic<int> remaining { options.midiFiles.size() };
+
+    auto start = juce::Time::getHighResolutionTicks();
+    {
+        juce::ThreadPool pool(std::min(options.jobs, options.midiFiles.size()));
+        for (int i = 0; i < options.midiFiles.size(); ++i)
+        {
+            pool.addJob([&options, &results, &remaining, i]
+            {
+                results[static_cast<size_t>(i)] = renderFile(options, options.midiFiles[i]);
+                --remaining;
+            });
+        }
+        while (remaining.load() > 0)
+        {
+            juce::Thread::sleep(10);
+        }
+    }
+    double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+    double audioSeconds = 0.0;
+    int failures = 0;
+    for (int i = 0; i < options.midiFiles.size(); ++i)
+    {
+        const Result& result = results[static_cast<size_t>(i)];
+        if (result.error.isNotEmpty())
+        {
+            std::cerr << result.error << std::endl;
+            ++failures;
+            continue;
+        }
+        audioSeconds += result.audioSeconds;
+        std::cout << options.midiFiles[i].getFileName() << "\t" << result.audioSeconds << " s audio\t"
+                  << result.audioSeconds / result.renderSeconds << "x real time\n";
+    }
+    std::cout << "total\t" << audioSeconds << " s audio in " << wallSeconds << " s\t"
+              << audioSeconds / wallSeconds << "x real time on " << std::min(options.jobs, options.midiFiles.size()) << " jobs" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
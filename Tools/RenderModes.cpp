@@ -0,0 +1,427 @@
+// Renders every factory preset with each of the synth's render paths and checks that the
+// block and voice bank paths play what the scalar reference path plays.
+//
+//     JX11RenderModes [--filter text]
+//
+//     --filter     only the tests whose name contains the text
+//
+// Each preset plays with the shared settings at their defaults, and again with the wavetable
+// engine, the audio-rate filter and unison, since those take their own code in every path.
+//
+// The voice bank runs the scalar path's operations in the same order, so its BLIT voices have
+// to match the scalar path to within SAMPLE_TOLERANCE, which leaves room for a compiler that
+// fuses a multiply and an add in one path and not in the other. The table and unison voices
+// it hands to the block path's code, so there it has to match block mode to the same
+// tolerance. Block mode works out the envelope in closed form, which rounds differently: a
+// voice can run out a sample apart and keep another oscillator phase for its next note, or
+// be the one stolen. Until the block in which the first voice runs out or is stolen, it has
+// to match the scalar path sample by sample to within BLOCK_SAMPLE_TOLERANCE. From then on
+// it only has to match the scalar path's level, over windows of LEVEL_WINDOW samples, to
+// within LEVEL_TOLERANCE_DB.
+//
+// In Multi mode the first two parts each play the script on their own channel, the second
+// after a Program Change, and have to match Omni mode exactly. The script split over both
+// channels has no such reference, since each part keeps its own voices and glide, so it
+// runs the same comparisons between paths as the presets do.
+//
+// Merging controller messages only cuts the blocks in fewer places. With the default
+// controller window a script has to play exactly what it plays with merging turned off once
+// each window of it is merged by hand, and notes alone exactly the same either way.
+//
+// Rendering on worker threads must not change a bit, so the threaded tests render the block
+// and voice bank paths with RENDER_THREADS workers and compare them with the same path on
+// the calling thread alone.
+//
+// The SIMD backend is chosen when the synth is compiled, so the build makes this tool once
+// for each: JX11RenderModes with the default one, JX11RenderModesAVX and JX11RenderModesLoop.
+// It exits with 1 if any test is off.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr double SECONDS = 3.0;
+static constexpr float SAMPLE_TOLERANCE = 1e-6f;
+static constexpr int LEVEL_WINDOW = 4096;
+static constexpr float BLOCK_SAMPLE_TOLERANCE = 1e-3f;   // the worst preset reaches 6e-4
+static constexpr double LEVEL_TOLERANCE_DB = 0.75;        // and 0.6 dB
+static constexpr int RENDER_THREADS = 4;
+
+// Blocks of changing sizes, so events land everywhere within a block.
+static constexpr int BLOCK_SIZES[] = { 512, 100, 256, 37, 480 };
+static constexpr int MAX_BLOCK_SIZE = 512;
+
+// How often the controllers move in the script for the controller window.
+static constexpr int CONTROLLER_INTERVAL = 7;
+
+struct Variant
+{
+    const char* name;
+    bool bankLanes;     // whether the voice bank renders the voices in its SIMD lanes
+    int renderThreads;  // more than 0 compares the threaded paths with themselves on one thread
+    int channels;       // MIDI channels the script's notes take turns over, in Multi mode if more than 1
+    std::function<void(JX11AudioProcessor&)> setUp;
+};
+
+static void setParameter(JX11AudioProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter = processor.apvts.getParameter(id.getParamID());
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+static void setMulti(JX11AudioProcessor& processor)
+{
+    setParameter(processor, ParameterID::midiMode, 1.0f);
+}
+
+static const Variant variants[] =
+{
+    { "default", true, 0, 1, nullptr },
+    { "wavetable", false, 0, 1, [](JX11AudioProcessor& p) { setParameter(p, ParameterID::oscEngine, 1.0f); } },
+    { "audio-rate filter", true, 0, 1, [](JX11AudioProcessor& p) { setParameter(p, ParameterID::filterRate, 1.0f); } },
+    { "unison", false, 0, 1, [](JX11AudioProcessor& p) { setParameter(p, ParameterID::unison, 3.0f); } },
+    { "threaded", true, RENDER_THREADS, 1, nullptr },
+    { "multi, two channels", true, 0, 2, setMulti },
+};
+
+static const Variant multi = { "multi", true, 0, 1, setMulti };
+static const Variant unmerged = { "unmerged", true, 0, 1, [](JX11AudioProcessor& p) { p.controllerWindow = 0; } };
+
+static const char* backendName()
+{
+#if JX11_USE_AVX
+    return "AVX";
+#elif JX11_USE_SSE
+    return "SSE2";
+#else
+    return "loop";
+#endif
+}
+
+static void add(juce::MidiMessageSequence& sequence, double time, juce::MidiMessage message)
+{
+    message.setTimeStamp(time);
+    sequence.addEvent(message);
+}
+
+static void note(juce::MidiMessageSequence& sequence, int channel, double on, double off, int number, int velocity)
+{
+    add(sequence, on, juce::MidiMessage::noteOn(channel, number, static_cast<juce::uint8>(velocity)));
+    add(sequence, off, juce::MidiMessage::noteOff(channel, number));
+}
+
+// More notes than the voice bank has lanes, held under the pedal, with the pitch and mod
+// wheels moving, then a run that steals voices. The notes take turns over channels MIDI
+// channels from firstChannel on, and every one of those gets the controllers. Channels
+// after the first switch to the program before anything plays, for Multi mode's parts.
+static juce::MidiMessageSequence createScript(int program = 0, int firstChannel = 1, int channels = 1)
+{
+    juce::MidiMessageSequence s;
+    for (int channel = std::max(firstChannel, 2); channel < firstChannel + channels; ++channel)
+    {
+        add(s, 0.0, juce::MidiMessage::programChange(channel, program));
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        note(s, firstChannel + i % channels, 0.05 * i, 1.0 + 0.05 * i, 40 + 4 * i, 50 + 7 * i);
+    }
+    for (int channel = firstChannel; channel < firstChannel + channels; ++channel)
+    {
+        add(s, 0.3, juce::MidiMessage::controllerEvent(channel, 0x40, 127));
+        for (int i = 0; i <= 100; ++i)
+        {
+            add(s, 0.5 + 0.01 * i, juce::MidiMessage::pitchWheel(channel, 8192 + 40 * i));
+            add(s, 0.5 + 0.01 * i, juce::MidiMessage::controllerEvent(channel, 0x01, i));
+        }
+        add(s, 1.8, juce::MidiMessage::controllerEvent(channel, 0x40, 0));
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        note(s, firstChannel + i % channels, 2.0 + 0.05 * i, 2.3 + 0.05 * i, 60 + i, 100);
+    }
+    s.sort();
+    return s;
+}
+
+// Chords with the controllers that are read only at the control tick, the mod wheel,
+// channel pressure and the filter controllers, moving every CONTROLLER_INTERVAL samples. Or
+// the chords alone.
+static juce::MidiMessageSequence createControllerScript(bool controllers)
+{
+    juce::MidiMessageSequence s;
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            note(s, 1, 0.4 * i + 0.01 * j, 0.4 * i + 0.3, 45 + 2 * i + 4 * j, 60 + 10 * j);
+        }
+    }
+    for (int i = 0; controllers && i < static_cast<int>(2.5 * SAMPLE_RATE) / CONTROLLER_INTERVAL; ++i)
+    {
+        // Sweeps up and down, as a hand on a wheel would move them.
+        auto sweep = [i](int period) { int phase = i % (2 * period); return 127 * std::min(phase, 2 * period - phase) / period; };
+        double time = i * CONTROLLER_INTERVAL / SAMPLE_RATE;
+        add(s, time, juce::MidiMessage::controllerEvent(1, 0x01, sweep(1500)));
+        add(s, time, juce::MidiMessage::channelPressureChange(1, sweep(1100)));
+        add(s, time, juce::MidiMessage::controllerEvent(1, (i / 3000) % 2 == 0 ? 0x4A : 0x4B, sweep(700)));
+    }
+    s.sort();
+    return s;
+}
+
+// The controller script as the processor merges it by default. Within each window of LFO_MAX
+// samples that ends on a control tick, cut short by the end of a block and by any other
+// event, only the last value of each controller is sent, all of them where the last message
+// came in. Control ticks fall on every LFO_MAX-th sample from the first.
+static juce::MidiMessageSequence mergeControllers(const juce::MidiMessageSequence& sequence)
+{
+    juce::MidiMessageSequence merged;
+    std::vector<juce::MidiMessage> held;
+    int heldPosition = 0;
+    auto release = [&]
+    {
+        for (const auto& message : held) { add(merged, heldPosition / SAMPLE_RATE, message); }
+        held.clear();
+    };
+    auto window = [](int sample) { return (sample + Synth::LFO_MAX - 1) / Synth::LFO_MAX; };
+
+    int blockEnd = BLOCK_SIZES[0];
+    for (int i = 0, block = 0; i < sequence.getNumEvents(); ++i)
+    {
+        const auto& message = sequence.getEventPointer(i)->message;
+        int sample = static_cast<int>(std::lround(message.getTimeStamp() * SAMPLE_RATE));
+        while (sample >= blockEnd)
+        {
+            release();
+            blockEnd += BLOCK_SIZES[static_cast<size_t>(++block) % std::size(BLOCK_SIZES)];
+        }
+
+        const juce::uint8* data = message.getRawData();
+        bool numbered = (data[0] & 0xF0) == 0xB0;
+        if ((data[0] & 0xF0) != 0xD0 && !(numbered && (data[1] == 0x01 || data[1] == 0x4A || data[1] == 0x4B)))
+        {
+            release();
+            add(merged, message.getTimeStamp(), message);
+            continue;
+        }
+
+        if (!held.empty() && window(sample) != window(heldPosition)) { release(); }
+        std::erase_if(held, [&](const juce::MidiMessage& other)
+        {
+            return other.getRawData()[0] == data[0] && (!numbered || other.getRawData()[1] == data[1]);
+        });
+        held.push_back(message);
+        heldPosition = sample;
+    }
+    release();
+    return merged;
+}
+
+// voicesIntact, if given, gets the number of samples before the block in which the first voice
+// ran out or was stolen.
+static juce::AudioBuffer<float> render(int program, const Variant& variant, Synth::RenderMode mode, const juce::MidiMessageSequence& sequence,
+                                       int* voicesIntact = nullptr)
+{
+    JX11AudioProcessor processor;
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(0, 2, SAMPLE_RATE, MAX_BLOCK_SIZE);
+    processor.setCurrentProgram(program);
+    if (variant.setUp) { variant.setUp(processor); }
+    processor.setRenderMode(mode);
+    processor.setRenderThreads(variant.renderThreads);
+    processor.prepareToPlay(SAMPLE_RATE, MAX_BLOCK_SIZE);
+
+    int totalSamples = static_cast<int>(SECONDS * SAMPLE_RATE);
+    if (voicesIntact != nullptr) { *voicesIntact = totalSamples; }
+    juce::AudioBuffer<float> output(2, totalSamples);
+    juce::AudioBuffer<float> buffer(2, MAX_BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+
+    int nextEvent = 0;
+    for (int position = 0, block = 0; position < totalSamples; position += buffer.getNumSamples(), ++block)
+    {
+        int sampleCount = std::min(BLOCK_SIZES[static_cast<size_t>(block) % std::size(BLOCK_SIZES)], totalSamples - position);
+        buffer.setSize(2, sampleCount, false, false, true);
+
+        midiMessages.clear();
+        for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+        {
+            const auto& message = sequence.getEventPointer(nextEvent)->message;
+            int sample = static_cast<int>(std::lround(message.getTimeStamp() * SAMPLE_RATE));
+            if (sample >= position + sampleCount) { break; }
+            midiMessages.addEvent(message, std::max(sample - position, 0));
+        }
+
+        processor.processBlock(buffer, midiMessages);
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            output.copyFrom(channel, position, buffer, channel, 0, sampleCount);
+        }
+
+        auto stats = processor.getEngineStats();
+        if (voicesIntact != nullptr && *voicesIntact == totalSamples && stats.voiceEnds + stats.voiceSteals > 0)
+        {
+            *voicesIntact = position;
+        }
+    }
+    return output;
+}
+
+// Over the first sampleCount samples, or all of them.
+static float maxDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b, int sampleCount = -1)
+{
+    if (sampleCount < 0) { sampleCount = a.getNumSamples(); }
+
+    float largest = 0.0f;
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        const float* x = a.getReadPointer(channel);
+        const float* y = b.getReadPointer(channel);
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            float difference = std::abs(x[i] - y[i]);
+            if (!(difference <= largest)) { largest = difference; }  // NaN counts as off
+        }
+    }
+    return largest;
+}
+
+// The largest difference in dB between the RMS levels of a window, with everything under
+// -80 dB taken as -80 dB so that differences in silence do not count.
+static double levelDifference(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+{
+    auto level = [](const float* samples)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < LEVEL_WINDOW; ++i) { sum += static_cast<double>(samples[i]) * samples[i]; }
+        return 10.0 * std::log10(std::max(sum / LEVEL_WINDOW, 1e-8));
+    };
+
+    double largest = 0.0;
+    for (int channel = 0; channel < 2; ++channel)
+    {
+        for (int start = 0; start + LEVEL_WINDOW <= a.getNumSamples(); start += LEVEL_WINDOW)
+        {
+            double difference = std::abs(level(a.getReadPointer(channel) + start) - level(b.getReadPointer(channel) + start));
+            if (!(difference <= largest)) { largest = difference; }
+        }
+    }
+    return largest;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    juce::String filter;
+    if (argc == 3 && juce::String(argv[1]) == "--filter")
+    {
+        filter = argv[2];
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "Usage: JX11RenderModes [--filter text]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "SIMD backend " << backendName() << ", voice bank within " << SAMPLE_TOLERANCE
+              << ", block mode within " << BLOCK_SAMPLE_TOLERANCE << " until a voice ends and "
+              << LEVEL_TOLERANCE_DB << " dB after, threaded paths, Multi mode's parts and merged controllers exactly\n";
+
+    JX11AudioProcessor names;
+    int tests = 0;
+    int failures = 0;
+    auto report = [&](const juce::String& name, bool passed, const juce::String& difference)
+    {
+        ++tests;
+        if (!passed)
+        {
+            std::cout << "FAIL " << name << ": " << difference << "\n";
+            ++failures;
+        }
+    };
+
+    for (int program = 0; program < names.getNumPrograms(); ++program)
+    {
+        for (const Variant& variant : variants)
+        {
+            juce::String prefix = names.getProgramName(program) + "/" + variant.name + "/";
+            juce::MidiMessageSequence sequence = createScript(program, 1, variant.channels);
+
+            if (variant.renderThreads > 0)
+            {
+                Variant single = variant;
+                single.renderThreads = 0;
+                for (auto mode : { Synth::RenderMode::block, Synth::RenderMode::voiceBank })
+                {
+                    juce::String name = prefix + (mode == Synth::RenderMode::block ? "block" : "voiceBank");
+                    if (!name.contains(filter)) { continue; }
+
+                    float difference = maxDifference(render(program, single, mode, sequence), render(program, variant, mode, sequence));
+                    report(name, difference == 0.0f, "largest difference " + juce::String(difference));
+                }
+                continue;
+            }
+            bool checkBlock = (prefix + "block").contains(filter);
+            bool checkBank = (prefix + "voiceBank").contains(filter);
+            if (!checkBlock && !checkBank) { continue; }
+
+            int scalarIntact = 0;
+            int blockIntact = 0;
+            auto scalar = render(program, variant, Synth::RenderMode::scalar, sequence, &scalarIntact);
+            auto block = render(program, variant, Synth::RenderMode::block, sequence, &blockIntact);
+            if (checkBlock)
+            {
+                int intact = std::min(scalarIntact, blockIntact);
+                float difference = maxDifference(scalar, block, intact);
+                double levels = levelDifference(scalar, block);
+                report(prefix + "block", difference <= BLOCK_SAMPLE_TOLERANCE && levels <= LEVEL_TOLERANCE_DB,
+                       "largest difference " + juce::String(difference) + " in the first " + juce::String(intact)
+                       + " samples, level differs by " + juce::String(levels) + " dB");
+            }
+            if (checkBank)
+            {
+                auto bank = render(program, variant, Synth::RenderMode::voiceBank, sequence);
+                float difference = maxDifference(variant.bankLanes ? scalar : block, bank);
+                report(prefix + "voiceBank", difference <= SAMPLE_TOLERANCE, "largest difference " + juce::String(difference));
+            }
+        }
+
+        for (auto mode : { Synth::RenderMode::scalar, Synth::RenderMode::block, Synth::RenderMode::voiceBank })
+        {
+            juce::String modeName = mode == Synth::RenderMode::scalar ? "scalar" : mode == Synth::RenderMode::block ? "block" : "voiceBank";
+            juce::AudioBuffer<float> omni;
+            for (int channel : { 1, 2 })
+            {
+                juce::String name = names.getProgramName(program) + "/multi, channel " + juce::String(channel) + "/" + modeName;
+                if (!name.contains(filter)) { continue; }
+
+                if (omni.getNumSamples() == 0) { omni = render(program, variants[0], mode, createScript()); }
+                float difference = maxDifference(omni, render(program, multi, mode, createScript(program, channel)));
+                report(name, difference == 0.0f, "largest difference " + juce::String(difference));
+            }
+
+            juce::String prefix = names.getProgramName(program) + "/controller window";
+            if ((prefix + ", notes only/" + modeName).contains(filter))
+            {
+                juce::MidiMessageSequence script = createControllerScript(false);
+                float difference = maxDifference(render(program, variants[0], mode, script), render(program, unmerged, mode, script));
+                report(prefix + ", notes only/" + modeName, difference == 0.0f, "largest difference " + juce::String(difference));
+            }
+            if ((prefix + "/" + modeName).contains(filter))
+            {
+                juce::MidiMessageSequence script = createControllerScript(true);
+                float difference = maxDifference(render(program, unmerged, mode, mergeControllers(script)), render(program, variants[0], mode, script));
+                report(prefix + "/" + modeName, difference == 0.0f, "largest difference " + juce::String(difference));
+            }
+        }
+    }
+
+    std::cout << "passed " << tests - failures << " of " << tests << " tests" << std::endl;
+    return failures == 0 && tests > 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+// Checks that a processor restoring a saved render state carries on exactly where the state
+// was saved.
+//
+//     JX11RenderStateCheck
+//
+// Every factory preset plays a timeline in Multi mode: a chord on the first channel, a run on
+// the second after a Program Change there, and the mod wheel and pitch wheel moving on both.
+// Partway through, the host turns the unison detune and the MIDI mode, which sets the second
+// part up again from its program, back and forth. It is rendered in one go, with the render state saved every PIECE_BLOCKS blocks. Each piece
+// after the first is then rendered again by a new processor, set up the same way, that starts
+// from the state saved at its start, and has to come out the same to the bit. The scalar,
+// block and voice bank paths each take a turn.
+//
+// Prints each piece that differs and exits with 1 if there is one.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+static constexpr double SAMPLE_RATE = 48000.0;
+static constexpr int BLOCKS = 400;
+static constexpr int PIECE_BLOCKS = 37;
+
+// Blocks of changing sizes, so the pieces start at all sorts of places in the control ticks.
+static constexpr int BLOCK_SIZES[] = { 512, 100, 256, 37, 480 };
+static constexpr int MAX_BLOCK_SIZE = 512;
+
+static void setParameter(JX11AudioProcessor& processor, const juce::ParameterID& id, float value)
+{
+    auto* parameter = processor.apvts.getParameter(id.getParamID());
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+static int blockSize(int block)
+{
+    return BLOCK_SIZES[static_cast<size_t>(block) % std::size(BLOCK_SIZES)];
+}
+
+// Host automation between blocks, the same in both renders.
+static void changeParameters(JX11AudioProcessor& processor, int block)
+{
+    if (block == 150) { setParameter(processor, ParameterID::unisonDetune, 40.0f); }
+    if (block == 230) { setParameter(processor, ParameterID::midiMode, 0.0f); }
+    if (block == 260) { setParameter(processor, ParameterID::midiMode, 1.0f); }
+}
+
+static void add(juce::MidiMessageSequence& sequence, double time, juce::MidiMessage message)
+{
+    message.setTimeStamp(time);
+    sequence.addEvent(message);
+}
+
+static juce::MidiMessageSequence createScript(int secondProgram)
+{
+    juce::MidiMessageSequence s;
+    add(s, 0.0, juce::MidiMessage::programChange(2, secondProgram));
+    for (int i = 0; i < 4; ++i)
+    {
+        add(s, 0.1 * i, juce::MidiMessage::noteOn(1, 48 + 7 * i, static_cast<juce::uint8>(70 + 10 * i)));
+        add(s, 1.5 + 0.1 * i, juce::MidiMessage::noteOff(1, 48 + 7 * i));
+    }
+    for (int i = 0; i < 24; ++i)
+    {
+        add(s, 0.5 + 0.1 * i, juce::MidiMessage::noteOn(2, 60 + (5 * i) % 17, static_cast<juce::uint8>(100)));
+        add(s, 0.58 + 0.1 * i, juce::MidiMessage::noteOff(2, 60 + (5 * i) % 17));
+    }
+    for (int i = 0; i <= 200; ++i)
+    {
+        for (int channel : { 1, 2 })
+        {
+            add(s, 0.01 * i, juce::MidiMessage::controllerEvent(channel, 0x01, (i * channel) % 128));
+            add(s, 0.01 * i + 0.005, juce::MidiMessage::pitchWheel(channel, 8192 + 30 * (i % 100) * channel));
+        }
+    }
+    s.sort();
+    return s;
+}
+
+static std::unique_ptr<JX11AudioProcessor> createProcessor(int program, Synth::RenderMode mode)
+{
+    auto processor = std::make_unique<JX11AudioProcessor>();
+    processor->setNonRealtime(true);
+    processor->setPlayConfigDetails(0, 2, SAMPLE_RATE, MAX_BLOCK_SIZE);
+    processor->setCurrentProgram(program);
+    setParameter(*processor, ParameterID::midiMode, 1.0f);
+    processor->setRenderMode(mode);
+    processor->prepareToPlay(SAMPLE_RATE, MAX_BLOCK_SIZE);
+    return processor;
+}
+
+// Renders blocks first to last - 1 of the timeline into output at their places. Before each
+// block that starts a piece, the render state goes to states if it is given.
+static void renderBlocks(JX11AudioProcessor& processor, const juce::MidiMessageSequence& sequence, int first, int last,
+                         juce::AudioBuffer<float>& output, std::vector<JX11AudioProcessor::RenderState>* states)
+{
+    int position = 0;
+    for (int block = 0; block < first; ++block) { position += blockSize(block); }
+
+    juce::AudioBuffer<float> buffer(2, MAX_BLOCK_SIZE);
+    juce::MidiBuffer midiMessages;
+    for (int block = first; block < last; position += blockSize(block), ++block)
+    {
+        if (states != nullptr && block % PIECE_BLOCKS == 0)
+        {
+            processor.saveRenderState((*states)[static_cast<size_t>(block / PIECE_BLOCKS)]);
+        }
+
+        int sampleCount = blockSize(block);
+        buffer.setSize(2, sampleCount, false, false, true);
+        midiMessages.clear();
+        for (int i = 0; i < sequence.getNumEvents(); ++i)
+        {
+            const auto& message = sequence.getEventPointer(i)->message;
+            int sample = static_cast<int>(std::lround(message.getTimeStamp() * SAMPLE_RATE));
+            if (sample >= position && sample < position + sampleCount)
+            {
+                midiMessages.addEvent(message, sample - position);
+            }
+        }
+
+        changeParameters(processor, block);
+        processor.processBlock(buffer, midiMessages);
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            output.copyFrom(channel, position, buffer, channel, 0, sampleCount);
+        }
+    }
+}
+
+static int totalSamples(int blocks)
+{
+    int samples = 0;
+    for (int block = 0; block < blocks; ++block) { samples += blockSize(block); }
+    return samples;
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    JX11AudioProcessor names;
+    int pieceCount = (BLOCKS + PIECE_BLOCKS - 1) / PIECE_BLOCKS;
+    int checks = 0;
+    int failures = 0;
+    for (int program = 0; program < names.getNumPrograms(); ++program)
+    {
+        juce::MidiMessageSequence script = createScript((program + 1) % names.getNumPrograms());
+        for (auto mode : { Synth::RenderMode::scalar, Synth::RenderMode::block, Synth::RenderMode::voiceBank })
+        {
+            juce::String name = names.getProgramName(program) + "/"
+                              + (mode == Synth::RenderMode::scalar ? "scalar" : mode == Synth::RenderMode::block ? "block" : "voiceBank");
+
+            juce::AudioBuffer<float> inOneGo(2, totalSamples(BLOCKS));
+            std::vector<JX11AudioProcessor::RenderState> states(static_cast<size_t>(pieceCount));
+            renderBlocks(*createProcessor(program, mode), script, 0, BLOCKS, inOneGo, &states);
+
+            juce::AudioBuffer<float> inPieces(2, inOneGo.getNumSamples());
+            for (int piece = 1; piece < pieceCount; ++piece)
+            {
+                ++checks;
+                int first = piece * PIECE_BLOCKS;
+                int last = std::min(first + PIECE_BLOCKS, BLOCKS);
+                auto processor = createProcessor(program, mode);
+                if (!processor->restoreRenderState(states[static_cast<size_t>(piece)]))
+                {
+                    std::cout << "FAIL " << name << ": the state of piece " << piece << " does not restore\n";
+                    ++failures;
+                    continue;
+                }
+                renderBlocks(*processor, script, first, last, inPieces, nullptr);
+
+                int start = totalSamples(first);
+                int length = totalSamples(last) - start;
+                for (int channel = 0; channel < 2; ++channel)
+                {
+                    if (std::memcmp(inOneGo.getReadPointer(channel, start), inPieces.getReadPointer(channel, start), sizeof(float) * static_cast<size_t>(length)) != 0)
+                    {
+                        std::cout << "FAIL " << name << ": piece " << piece << " differs\n";
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "passed " << checks - failures << " of " << checks << " pieces" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Checks the smoothers in Smoothing.h against what they promise.
+//
+//     JX11SmoothingCheck
+//
+// LinearRamp::applyGain has to give exactly what the same number of getNextValue calls give.
+// Each ramp length runs a random stream of new targets, some of them in the middle of a ramp,
+// through blocks of changing sizes, so ramps start, end and change direction inside blocks
+// and across their edges. ControlSmoother ramps have to land exactly on their targets after
+// the number of ticks they were given.
+//
+// Prints the outcome of each check and exits with 1 if one is off.
+
+#include <JuceHeader.h>
+#include "Smoothing.h"
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static constexpr int SAMPLES = 1 << 16;
+static constexpr int MAX_BLOCK_SIZE = 300;
+
+// Ramp lengths in samples, with the ones that take the short ways through applyGain.
+static constexpr int RAMP_STEPS[] = { 0, 1, 2, 3, 7, 64, 255, 1000 };
+static constexpr int BLOCK_SIZES[] = { 1, 37, 300, 2, 64, 129, 5, 256 };
+
+// The number of samples where applyGain, on its own buffer and in place, did not give the
+// bits that getNextValue did.
+static int checkLinearRamp(int steps, juce::Random& random)
+{
+    LinearRamp bySample, byBlock, inPlace;
+    for (LinearRamp* ramp : { &bySample, &byBlock, &inPlace })
+    {
+        ramp->reset(1.0, static_cast<double>(steps));
+        ramp->setCurrentAndTargetValue(1.0f);
+    }
+
+    std::vector<float> input(MAX_BLOCK_SIZE), expected(MAX_BLOCK_SIZE), output(MAX_BLOCK_SIZE), buffer(MAX_BLOCK_SIZE);
+    int mismatches = 0;
+    for (int position = 0, block = 0; position < SAMPLES; ++block)
+    {
+        int sampleCount = BLOCK_SIZES[static_cast<size_t>(block) % std::size(BLOCK_SIZES)];
+
+        // Now and then a new target, which as often as not interrupts a ramp under way.
+        if (random.nextInt(3) == 0)
+        {
+            float target = random.nextFloat() * 4.0f - 1.0f;
+            for (LinearRamp* ramp : { &bySample, &byBlock, &inPlace }) { ramp->setTargetValue(target); }
+        }
+
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            input[static_cast<size_t>(i)] = random.nextFloat() * 2.0f - 1.0f;
+            expected[static_cast<size_t>(i)] = input[static_cast<size_t>(i)] * bySample.getNextValue();
+        }
+        byBlock.applyGain(output.data(), input.data(), sampleCount);
+        std::copy(input.begin(), input.begin() + sampleCount, buffer.begin());
+        inPlace.applyGain(buffer.data(), sampleCount);
+
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            const float* want = &expected[static_cast<size_t>(i)];
+            if (std::memcmp(want, &output[static_cast<size_t>(i)], sizeof(float)) != 0) { ++mismatches; }
+            if (std::memcmp(want, &buffer[static_cast<size_t>(i)], sizeof(float)) != 0) { ++mismatches; }
+        }
+
+        // The ramps have to carry on from the same place.
+        float current = bySample.getCurrentValue();
+        if (byBlock.getCurrentValue() != current || inPlace.getCurrentValue() != current) { ++mismatches; }
+        position += sampleCount;
+    }
+    return mismatches;
+}
+
+// The number of ramps that were not on their targets after the ticks they were given, and of
+// ticks before that on which the smoother had already stopped.
+static int checkControlSmoother(int steps, juce::Random& random)
+{
+    ControlSmoother smoother;
+    smoother.reset(steps);
+
+    float values[ControlSmoother::MAX_RAMPS];
+    float targets[ControlSmoother::MAX_RAMPS];
+    int misses = 0;
+    for (int round = 0; round < 1000; ++round)
+    {
+        for (int i = 0; i < ControlSmoother::MAX_RAMPS; ++i)
+        {
+            values[i] = 0.1f + random.nextFloat() * 10.0f;
+            targets[i] = 0.1f + random.nextFloat() * 10.0f;
+        }
+        for (int i = 0; i < ControlSmoother::MAX_RAMPS; ++i)
+        {
+            if (i % 2 == 0) { smoother.rampLinear(values[i], targets[i]); }
+            else { smoother.rampExponential(values[i], targets[i]); }
+        }
+
+        for (int tick = 1; tick <= steps; ++tick)
+        {
+            bool smoothing = smoother.isSmoothing();
+            smoother.advance();
+            if (!smoothing) { ++misses; }
+        }
+        for (int i = 0; i < ControlSmoother::MAX_RAMPS; ++i)
+        {
+            if (values[i] != targets[i]) { ++misses; }
+        }
+        if (smoother.isSmoothing()) { ++misses; }
+    }
+    return misses;
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    juce::Random random(12);
+    int failures = 0;
+    for (int steps : RAMP_STEPS)
+    {
+        int mismatches = checkLinearRamp(steps, random);
+        std::cout << (mismatches == 0 ? "ok   " : "FAIL ") << "LinearRamp over " << steps
+                  << " samples: applyGain differs from getNextValue in " << mismatches << " places\n";
+        if (mismatches != 0) { ++failures; }
+    }
+    for (int steps : { 1, 2, 8, 100 })
+    {
+        int misses = checkControlSmoother(steps, random);
+        std::cout << (misses == 0 ? "ok   " : "FAIL ") << "ControlSmoother over " << steps
+                  << " ticks: " << misses << " ramps off their targets or stopped early\n";
+        if (misses != 0) { ++failures; }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// Times saving and loading the plugin state, per instance, as a session with many instances
+// would. Compares the binary state with the XML state earlier versions saved.
+//
+//     JX11StateBenchmark [instances] [rounds]
+//
+// Exits with 1 if either state brings back other values than the instance saved, or if a
+// state that has fewer values than its ID table has IDs does not set the rest to their
+// defaults.
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// The state as earlier versions saved it.
+static void getXmlState(JX11AudioProcessor& processor, juce::MemoryBlock& destData)
+{
+    auto state = processor.apvts.copyState();
+    juce::StringArray programs;
+    for (int p = 0; p < Synth::NUM_PARTS; ++p)
+    {
+        programs.add("0");
+    }
+    state.setProperty("partPrograms", programs.joinIntoString(" "), nullptr);
+    state.setProperty("presetBank", "", nullptr);
+    state.setProperty("morphPrograms", "-1 -1", nullptr);
+    juce::AudioProcessor::copyXmlToBinary(*state.createXml(), destData);
+}
+
+// A state as a damaged host chunk could have it: the processor's ID table, but a parameter
+// count SHORT_BY less and only that many values, followed by valid settings. A reader that
+// trusted the ID table would take the settings for the last values.
+static constexpr uint32_t SHORT_BY = 2;
+
+static juce::MemoryBlock getShortState(JX11AudioProcessor& processor)
+{
+    juce::MemoryBlock full;
+    processor.getStateInformation(full);
+    const auto* data = static_cast<const uint8_t*>(full.getData());
+    uint32_t parameterCount = juce::ByteOrder::littleEndianInt(data + sizeof(SavedState::MAGIC) + 4);
+    uint32_t idTableSize = juce::ByteOrder::littleEndianInt(data + sizeof(SavedState::MAGIC) + 8);
+
+    juce::MemoryOutputStream out;
+    out.write(data, sizeof(SavedState::MAGIC) + 4);
+    out.writeInt(static_cast<int>(parameterCount - SHORT_BY));
+    out.writeInt(static_cast<int>(idTableSize));
+    out.write(data + SavedState::HEADER_SIZE, idTableSize + 4 * (parameterCount - SHORT_BY));
+    out.writeInt(1);   // one part program, with the bits of 1.0f
+    out.writeFloat(1.0f);
+    out.writeInt(-1);  // no morph
+    out.writeInt(-1);
+    out.writeInt(0);   // the factory presets
+    return out.getMemoryBlock();
+}
+
+// The best of the rounds, in microseconds per instance.
+template <typename Function>
+static double timePerInstance(int instances, int rounds, Function&& function)
+{
+    double best = 0.0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        for (size_t i = 0; i < static_cast<size_t>(instances); ++i)
+        {
+            function(i);
+        }
+        double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        double perInstance = 1e6 * seconds / instances;
+        best = round == 0 ? perInstance : std::min(best, perInstance);
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI initialiser;
+
+    int instances = argc > 1 ? std::max(1, juce::String(argv[1]).getIntValue()) : 200;
+    int rounds = argc > 2 ? std::max(1, juce::String(argv[2]).getIntValue()) : 5;
+
+    std::vector<std::unique_ptr<JX11AudioProcessor>> processors;
+    juce::Random random(1);
+    for (int i = 0; i < instances; ++i)
+    {
+        processors.push_back(std::make_unique<JX11AudioProcessor>());
+        for (auto* parameter : processors.back()->getParameters())
+        {
+            parameter->setValueNotifyingHost(random.nextFloat());
+        }
+    }
+
+    std::vector<juce::MemoryBlock> binaryStates(static_cast<size_t>(instances));
+    std::vector<juce::MemoryBlock> xmlStates(static_cast<size_t>(instances));
+
+    double binarySave = timePerInstance(instances, rounds, [&](size_t i) { processors[i]->getStateInformation(binaryStates[i]); });
+    double xmlSave = timePerInstance(instances, rounds, [&](size_t i) { getXmlState(*processors[i], xmlStates[i]); });
+
+    double binaryLoad = timePerInstance(instances, rounds, [&](size_t i)
+    {
+        processors[i]->setStateInformation(binaryStates[i].getData(), static_cast<int>(binaryStates[i].getSize()));
+    });
+    double xmlLoad = timePerInstance(instances, rounds, [&](size_t i)
+    {
+        processors[i]->setStateInformation(xmlStates[i].getData(), static_cast<int>(xmlStates[i].getSize()));
+    });
+
+    // Both states have to bring back the same values.
+    int mismatches = 0;
+    JX11AudioProcessor check;
+    for (size_t i = 0; i < processors.size(); ++i)
+    {
+        for (auto* state : { &binaryStates[i], &xmlStates[i] })
+        {
+            check.setStateInformation(state->getData(), static_cast<int>(state->getSize()));
+            const auto& expected = processors[i]->getParameters();
+            const auto& restored = check.getParameters();
+            for (size_t p = 0; p < expected.size(); ++p)
+            {
+                if (std::abs(expected[p]->getValue() - restored[p]->getValue()) > 1e-6f) { ++mismatches; }
+            }
+        }
+    }
+
+    // The values the short state has come back, those it lacks go to their defaults.
+    int shortMismatches = 0;
+    {
+        auto shortState = getShortState(*processors[0]);
+        check.setStateInformation(shortState.getData(), static_cast<int>(shortState.getSize()));
+        const auto& expected = processors[0]->getParameters();
+        const auto& restored = check.getParameters();
+        for (size_t p = 0; p < expected.size(); ++p)
+        {
+            float value = p + SHORT_BY < expected.size() ? expected[p]->getValue() : restored[p]->getDefaultValue();
+            if (std::abs(value - restored[p]->getValue()) > 1e-6f) { ++shortMismatches; }
+        }
+    }
+
+    std::cout << instances << " instances, best of " << rounds << " rounds, microseconds per instance\n";
+    std::cout << "binary  save " << binarySave << "  load " << binaryLoad << "  bytes " << binaryStates[0].getSize() << "\n";
+    std::cout << "xml     save " << xmlSave << "  load " << xmlLoad << "  bytes " << xmlStates[0].getSize() << "\n";
+    std::cout << "mismatched values " << mismatches << ", from a state with values missing " << shortMismatches << std::endl;
+    return mismatches == 0 && shortMismatches == 0 ? 0 : 1;
+}